@@ -0,0 +1,596 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   batchrender.cpp
+ * @author Rafael Palomar
+ * @date   Wed Jun 16 18:24:05 2010
+ *
+ * @brief  Offline batch rendering.
+ *
+ * This file contains the implementation of the offline batch render of
+ * basicGL. Every frame of a parameter sweep is rendered by GLWidget into
+ * a framebuffer object (the widget is never shown), read back through its
+ * frame capture and handed to a thread pool that encodes it as PNG, so
+ * the next frames are rendered while the previous ones are still being
+ * read back and compressed.
+ *
+ */
+
+#include "batchrender.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QQueue>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QGLFramebufferObject>
+
+#include "glwidget.h"
+
+//!Class BatchWidget.
+/*!
+ * GLWidget rendering into a framebuffer object, as the one of
+ * basicgl_bench does.
+ */
+class BatchWidget: public GLWidget{
+
+  private:
+	QGLFramebufferObject *fbo;
+
+  public:
+	BatchWidget(): fbo(0){
+
+		//Setters must not render; frames are driven by renderFrame().
+		setUpdatesEnabled(false);
+		//Nobody is there to dismiss a message box.
+		setLoadWarnings(false);
+	}
+
+	~BatchWidget(){
+
+		makeCurrent();
+		delete fbo;
+	}
+
+	bool initialize(int width, int height){
+
+		makeCurrent();
+		if(!isValid() || !QGLFramebufferObject::hasOpenGLFramebufferObjects())
+			return false;
+
+		fbo = new QGLFramebufferObject(width, height,
+									   QGLFramebufferObject::Depth);
+		if(!fbo->isValid())
+			return false;
+
+		fbo->bind();
+		glInit();
+		resizeGL(width, height);
+		return true;
+	}
+
+	void renderFrame(){
+
+		paintGL();
+	}
+};
+
+//!Class PngEncoder.
+/*!
+ * Encodes one frame on a thread of the pool and frees its slot in the
+ * queue of frames waiting to be encoded.
+ */
+class PngEncoder: public QRunnable{
+
+  private:
+	QImage image;
+	QString fileName;
+	QSemaphore *queueSlots;
+	QAtomicInt *failures;
+
+  public:
+	PngEncoder(const QImage &image, const QString &fileName,
+			   QSemaphore *queueSlots, QAtomicInt *failures):
+		image(image), fileName(fileName), queueSlots(queueSlots), failures(failures){}
+
+	void run(){
+
+		if(!image.save(fileName, "PNG"))
+			failures->ref();
+
+		//The image is the bulk of the queued memory.
+		image = QImage();
+		queueSlots->release();
+	}
+};
+
+//!Class PngWriter.
+/*!
+ * Receives the frames read back by the widget and queues them for
+ * encoding. At most two frames per encoding thread wait in the queue, so
+ * rendering stalls instead of buffering the whole sweep if encoding falls
+ * behind.
+ */
+class PngWriter: public FrameConsumer{
+
+  private:
+	QThreadPool encoders;
+	QSemaphore queueSlots;
+	QAtomicInt failures;
+	QQueue<QString> fileNames;
+
+  public:
+	PngWriter(int threads): failures(0){
+
+		if(threads > 0)
+			encoders.setMaxThreadCount(threads);
+		queueSlots.release(2*encoders.maxThreadCount());
+	}
+
+	//!Names the next frame rendered.
+	void enqueue(const QString &fileName){
+
+		fileNames.enqueue(fileName);
+	}
+
+	void frameCaptured(const CapturedFrame &frame){
+
+		//The copy flips the rows, which the GL reads bottom up.
+		QImage image = QImage(frame.pixels, frame.width, frame.height,
+							  frame.bytesPerLine, QImage::Format_RGB32).mirrored();
+
+		queueSlots.acquire();
+		encoders.start(new PngEncoder(image, fileNames.dequeue(), &queueSlots, &failures));
+	}
+
+	int finish(){
+
+		encoders.waitForDone();
+		return failures;
+	}
+
+	int threads() const{
+
+		return encoders.maxThreadCount();
+	}
+};
+
+/**
+ * @brief Parse integers.
+ *
+ * @param text comma separated integers.
+ * @param values the integers parsed.
+ * @param count number of integers expected.
+ *
+ * @return true if text has exactly count integers.
+ */
+static bool parseIntegers(const QString &text, int *values, int count){
+
+	QStringList fields = text.split(',');
+	if(fields.size() != count)
+		return false;
+
+	for(int i = 0; i < count; i++){
+		bool ok = false;
+		values[i] = fields[i].toInt(&ok);
+		if(!ok)
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief Parse color.
+ *
+ * @param text the color, as R,G,B with 0-255 components.
+ * @param color the color parsed.
+ *
+ * @return true if text is a valid color.
+ */
+static bool parseColor(const QString &text, SweepColor &color){
+
+	int values[3];
+	if(!parseIntegers(text, values, 3))
+		return false;
+
+	for(int i = 0; i < 3; i++)
+		if(values[i] < 0 || values[i] > 255)
+			return false;
+
+	color.red = values[0];
+	color.green = values[1];
+	color.blue = values[2];
+	return true;
+}
+
+/**
+ * @brief Parse texture.
+ *
+ * @param text an image file name, or "none".
+ * @param textures the list the texture is appended to.
+ *
+ * @return true if text is "none" or an existing file.
+ */
+static bool parseTexture(const QString &text, QStringList &textures){
+
+	if(text == "none"){
+		textures.append(QString());
+		return true;
+	}
+
+	//Checked here, as a failed load would stop on a message box.
+	if(!QFileInfo(text).isFile())
+		return false;
+
+	textures.append(text);
+	return true;
+}
+
+/**
+ * @brief Constructor.
+ *
+ * A sweep of no frames, to be filled by parse().
+ */
+RenderSweep::RenderSweep(){
+
+	width = 853;
+	height = 480;
+	threads = 0;
+	lighting = false;
+	reflection = false;
+}
+
+/**
+ * @brief Parse.
+ *
+ * Fills the sweep from the command line of the batch render:
+ * <ul>
+ * <li>--batch DIR: directory of the PNG files.</li>
+ * <li>--size WxH, --threads N, --lighting, --reflection.</li>
+ * <li>--rotation X,Y,Z: in degrees.</li>
+ * <li>--color, --ambient, --diffuse R,G,B: 0-255 components.</li>
+ * <li>--fog R,G,B,START,END, or --fog none.</li>
+ * <li>--cube-texture, --floor-texture FILE, or none.</li>
+ * </ul>
+ * The options after --reflection may be repeated to add values to the
+ * sweep. Lists left empty get a single default value.
+ *
+ * @param args the arguments of the program.
+ * @param error set to the argument at fault if parsing fails.
+ *
+ * @return true if the arguments describe a valid sweep.
+ */
+bool RenderSweep::parse(const QStringList &args, QString &error){
+
+	for(int i = 1; i < args.size(); i++){
+
+		bool ok = true;
+		QString option = args[i];
+		bool hasValue = i + 1 < args.size();
+
+		if(option == "--lighting")
+			lighting = true;
+		else if(option == "--reflection")
+			reflection = true;
+		else if(!hasValue)
+			ok = false;
+		else if(option == "--batch")
+			outputDir = args[++i];
+		else if(option == "--size"){
+			QStringList size = args[++i].split('x');
+			ok = size.size() == 2;
+			if(ok)
+				width = size[0].toInt(&ok);
+			if(ok)
+				height = size[1].toInt(&ok);
+			ok = ok && width > 0 && height > 0;
+		}
+		else if(option == "--threads"){
+			threads = args[++i].toInt(&ok);
+			ok = ok && threads >= 0;
+		}
+		else if(option == "--rotation"){
+			QStringList fields = args[++i].split(',');
+			SweepRotation rotation;
+			ok = fields.size() == 3;
+			if(ok)
+				rotation.x = fields[0].toFloat(&ok);
+			if(ok)
+				rotation.y = fields[1].toFloat(&ok);
+			if(ok)
+				rotation.z = fields[2].toFloat(&ok);
+			if(ok)
+				rotations.append(rotation);
+		}
+		else if(option == "--color" || option == "--ambient" || option == "--diffuse"){
+			SweepColor color;
+			ok = parseColor(args[++i], color);
+			if(ok && option == "--color")
+				cubeColors.append(color);
+			else if(ok && option == "--ambient")
+				ambientLights.append(color);
+			else if(ok)
+				diffuseLights.append(color);
+		}
+		else if(option == "--fog"){
+			SweepFog fog = {{0, 0, 0}, 0, 0};
+			int values[5];
+			if(args[++i] != "none"){
+				ok = parseIntegers(args[i], values, 5)
+					&& parseColor(args[i].section(',', 0, 2), fog.color)
+					&& values[3] >= 0 && values[4] > values[3];
+				if(ok){
+					fog.start = values[3];
+					fog.end = values[4];
+				}
+			}
+			if(ok)
+				fogs.append(fog);
+		}
+		else if(option == "--cube-texture")
+			ok = parseTexture(args[++i], cubeTextures);
+		else if(option == "--floor-texture")
+			ok = parseTexture(args[++i], floorTextures);
+		else
+			ok = false;
+
+		if(!ok){
+			error = option;
+			return false;
+		}
+	}
+
+	if(outputDir.isEmpty()){
+		error = "--batch";
+		return false;
+	}
+
+	SweepRotation rotation = {30.0f, 45.0f, 0.0f};
+	SweepColor cubeColor = {200, 80, 40};
+	SweepColor ambientLight = {64, 64, 64};
+	SweepColor diffuseLight = {220, 220, 220};
+	SweepFog fog = {{0, 0, 0}, 0, 0};
+
+	if(rotations.isEmpty())
+		rotations.append(rotation);
+	if(cubeColors.isEmpty())
+		cubeColors.append(cubeColor);
+	if(ambientLights.isEmpty())
+		ambientLights.append(ambientLight);
+	if(diffuseLights.isEmpty())
+		diffuseLights.append(diffuseLight);
+	if(fogs.isEmpty())
+		fogs.append(fog);
+	if(cubeTextures.isEmpty())
+		cubeTextures.append(QString());
+	if(floorTextures.isEmpty())
+		floorTextures.append(QString());
+
+	return true;
+}
+
+/**
+ * @brief Frame count.
+ *
+ * @return the number of frames of the sweep.
+ */
+int RenderSweep::frameCount() const{
+
+	return cubeTextures.size()*floorTextures.size()*ambientLights.size()
+		*diffuseLights.size()*fogs.size()*cubeColors.size()*rotations.size();
+}
+
+/**
+ * @brief Set texture.
+ *
+ * Textures the cube or the floor and waits for the image to be decoded,
+ * so the next frame uploads it.
+ *
+ * @param widget the batch widget.
+ * @param cube true for the cube, false for the floor.
+ * @param fileName the image file, empty to leave it untextured.
+ *
+ * @return false if the image could not be loaded.
+ */
+static bool setTexture(BatchWidget &widget, bool cube, const QString &fileName){
+
+	if(fileName.isEmpty()){
+		if(cube)
+			widget.disableCubeTexture();
+		else
+			widget.disableFloorTexture();
+		return true;
+	}
+
+	if(cube)
+		widget.enableCubeTexture(fileName);
+	else
+		widget.enableFloorTexture(fileName);
+
+	while(widget.texturesLoading())
+		QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+
+	//A texture that failed to load is disabled again.
+	SceneState scene = widget.sceneState();
+	return !(cube ? scene.cubeTextureKey : scene.floorTextureKey).isEmpty();
+}
+
+/**
+ * @brief Render sweep.
+ *
+ * Renders every frame of the sweep into frame_NNNNN.png files of its
+ * output directory, and lists the parameters of each one in index.csv.
+ * Textures change least often, as they are the slowest to switch.
+ *
+ * @param sweep the parameter sweep.
+ *
+ * @return 0 on success, 2 if no GL context with framebuffer objects could
+ * be created and 3 if a texture could not be loaded or a file could not be
+ * written.
+ */
+int renderSweep(const RenderSweep &sweep){
+
+	QTextStream err(stderr);
+
+	if(!QDir().mkpath(sweep.outputDir)){
+		err << "basicGL: cannot create " << sweep.outputDir << "\n";
+		return 3;
+	}
+
+	QDir outputDir(sweep.outputDir);
+	QFile indexFile(outputDir.filePath("index.csv"));
+	if(!indexFile.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)){
+		err << "basicGL: cannot write " << indexFile.fileName() << "\n";
+		return 3;
+	}
+
+	BatchWidget widget;
+
+	if(!widget.initialize(sweep.width, sweep.height)){
+		err << "basicGL: no GL context with framebuffer objects available\n";
+		return 2;
+	}
+
+	//Every frame is needed, so the capture waits rather than dropping.
+	PngWriter writer(sweep.threads);
+	widget.setFrameDropping(false);
+	widget.addFrameConsumer(&writer);
+
+	QTextStream index(&indexFile);
+	index << "file,rotation_x,rotation_y,rotation_z,cube_r,cube_g,cube_b,"
+		  << "ambient_r,ambient_g,ambient_b,diffuse_r,diffuse_g,diffuse_b,"
+		  << "fog_r,fog_g,fog_b,fog_start,fog_end,cube_texture,floor_texture\n";
+
+	SceneState scene = widget.sceneState();
+	scene.lighting = sweep.lighting;
+	scene.reflection = sweep.reflection;
+
+	QString cubeTexture;
+	QString floorTexture;
+	widget.disableCubeTexture();
+	widget.disableFloorTexture();
+
+	QElapsedTimer clock;
+	clock.start();
+
+	int frames = sweep.frameCount();
+	for(int frame = 0; frame < frames; frame++){
+
+		//Frame index to sweep values, rotations varying fastest.
+		int rest = frame;
+		const SweepRotation &rotation = sweep.rotations[rest % sweep.rotations.size()];
+		rest /= sweep.rotations.size();
+		const SweepColor &color = sweep.cubeColors[rest % sweep.cubeColors.size()];
+		rest /= sweep.cubeColors.size();
+		const SweepFog &fog = sweep.fogs[rest % sweep.fogs.size()];
+		rest /= sweep.fogs.size();
+		const SweepColor &diffuse = sweep.diffuseLights[rest % sweep.diffuseLights.size()];
+		rest /= sweep.diffuseLights.size();
+		const SweepColor &ambient = sweep.ambientLights[rest % sweep.ambientLights.size()];
+		rest /= sweep.ambientLights.size();
+		const QString &floorFile = sweep.floorTextures[rest % sweep.floorTextures.size()];
+		rest /= sweep.floorTextures.size();
+		const QString &cubeFile = sweep.cubeTextures[rest];
+
+		QString failed;
+
+		if(cubeFile != cubeTexture){
+			cubeTexture = cubeFile;
+			if(!setTexture(widget, true, cubeTexture))
+				failed = cubeTexture;
+		}
+
+		if(failed.isEmpty() && floorFile != floorTexture){
+			floorTexture = floorFile;
+			if(!setTexture(widget, false, floorTexture))
+				failed = floorTexture;
+		}
+
+		//Rendering on would list a texture the frames do not have.
+		if(!failed.isEmpty()){
+			err << "basicGL: cannot load texture " << failed << "\n";
+			widget.flushCapture();
+			widget.removeFrameConsumer(&writer);
+			writer.finish();
+			return 3;
+		}
+
+		scene.orientation = Quat::fromAxisAngle(rotation.x, 1.0f, 0.0f, 0.0f)
+			*Quat::fromAxisAngle(rotation.y, 0.0f, 1.0f, 0.0f)
+			*Quat::fromAxisAngle(rotation.z, 0.0f, 0.0f, 1.0f);
+		scene.cubeColor[0] = color.red;
+		scene.cubeColor[1] = color.green;
+		scene.cubeColor[2] = color.blue;
+		scene.ambientLight[0] = ambient.red/256.0f;
+		scene.ambientLight[1] = ambient.green/256.0f;
+		scene.ambientLight[2] = ambient.blue/256.0f;
+		scene.diffuseLight[0] = diffuse.red/256.0f;
+		scene.diffuseLight[1] = diffuse.green/256.0f;
+		scene.diffuseLight[2] = diffuse.blue/256.0f;
+		scene.fog = fog.end > fog.start;
+		scene.fogColor[0] = fog.color.red/256.0f;
+		scene.fogColor[1] = fog.color.green/256.0f;
+		scene.fogColor[2] = fog.color.blue/256.0f;
+		scene.fogStart = fog.start;
+		scene.fogEnd = fog.end;
+
+		//Texture fields are ignored; they were set by setTexture().
+		widget.applySceneState(scene);
+
+		QString fileName = QString("frame_%1.png").arg(frame, 5, 10, QChar('0'));
+
+		writer.enqueue(outputDir.filePath(fileName));
+		widget.renderFrame();
+
+		index << fileName << "," << rotation.x << "," << rotation.y << "," << rotation.z
+			  << "," << color.red << "," << color.green << "," << color.blue
+			  << "," << ambient.red << "," << ambient.green << "," << ambient.blue
+			  << "," << diffuse.red << "," << diffuse.green << "," << diffuse.blue
+			  << "," << fog.color.red << "," << fog.color.green << "," << fog.color.blue
+			  << "," << fog.start << "," << fog.end
+			  << "," << cubeTexture << "," << floorTexture << "\n";
+	}
+
+	qint64 renderTime = clock.elapsed();
+	widget.flushCapture();
+	widget.removeFrameConsumer(&writer);
+	int failures = writer.finish();
+
+	QTextStream(stdout) << "basicGL: " << frames << " frames rendered in "
+						<< renderTime << " ms, encoded in " << clock.elapsed()
+						<< " ms with " << writer.threads() << " threads\n";
+
+	if(failures != 0){
+		err << "basicGL: " << failures << " frames could not be written to "
+			<< sweep.outputDir << "\n";
+		return 3;
+	}
+
+	return 0;
+}
@@ -0,0 +1,87 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   batchrender.h
+ * @author Rafael Palomar
+ * @date   Wed Jun 16 18:24:05 2010
+ *
+ * @brief  Offline batch rendering header.
+ *
+ * This file contains the declaration of the RenderSweep structure and
+ * of the function that renders it into PNG files.
+ *
+ */
+
+#ifndef BATCHRENDER_H
+#define BATCHRENDER_H
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+//!Rotation of the cube around its three axes, in degrees.
+struct SweepRotation{
+	float x;
+	float y;
+	float z;
+};
+
+//!Color with 0-255 components.
+struct SweepColor{
+	int red;
+	int green;
+	int blue;
+};
+
+//!Fog of a frame; disabled if end is not beyond start.
+struct SweepFog{
+	SweepColor color;
+	int start;
+	int end;
+};
+
+//!Parameter sweep of an offline batch render.
+/*!
+ * A frame is rendered for every combination of the values of the lists.
+ * Empty texture file names leave the cube or the floor untextured.
+ */
+struct RenderSweep{
+	QString outputDir;
+	int width;
+	int height;
+	int threads;                    //!< PNG encoders, 0 for one per core.
+	bool lighting;
+	bool reflection;
+	QList<SweepRotation> rotations;
+	QList<SweepColor> cubeColors;
+	QList<SweepColor> ambientLights;
+	QList<SweepColor> diffuseLights;
+	QList<SweepFog> fogs;
+	QStringList cubeTextures;
+	QStringList floorTextures;
+
+	RenderSweep();
+	bool parse(const QStringList &args, QString &error);
+	int frameCount() const;
+};
+
+int renderSweep(const RenderSweep &sweep);
+
+#endif
@@ -0,0 +1,481 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   bench.cpp
+ * @author Rafael Palomar
+ * @date   Mon May 17 19:02:31 2010
+ *
+ * @brief  Offscreen frame benchmark.
+ *
+ * This file contains the entry point of basicgl_bench, which renders
+ * the GLWidget scene into a framebuffer object (the widget is never
+ * shown) for a number of frames under scripted rotations and effect
+ * toggles, and writes the frame time statistics as JSON.
+ *
+ * The widget is a hidden QGLWidget, so an X display is still needed. On
+ * machines without a GPU it runs on Mesa's software rasterizer, e.g.:
+ *
+ *   LIBGL_ALWAYS_SOFTWARE=1 xvfb-run ./basicgl_bench --frames 200
+ *
+ * gl_calls_per_frame counts the GL entry points the linker can wrap. The
+ * GLSL pipeline goes through QGLFunctions, QGLShaderProgram and other
+ * entry points resolved at run time, so the count is only meaningful for
+ * the fixed function pipeline. When the counter is built in, the bench
+ * therefore draws with the fixed function pipeline (--fixed) by default;
+ * --glsl measures the GLSL programs instead, and reports a null
+ * gl_calls_per_frame with gl_calls_note saying why. Framebuffer binds and
+ * timer queries are never counted.
+ *
+ * --texture-budget sets the texture cache budget in MB, to see how the
+ * textured scenarios fare when textures are evicted; texture_cache_hits
+ * and texture_cache_misses count the lookups of the cache.
+ *
+ * With --capture every frame is also read back through the frame capture
+ * of GLWidget, to measure its cost; frames_captured and frames_dropped
+ * count the frames delivered and dropped.
+ *
+ * program_build_ms is the time spent building the shader programs. Run
+ * twice with BASICGL_PROGRAM_CACHE pointing to an empty directory to get
+ * it with a cold and then a warm program cache.
+ *
+ */
+
+#include <QApplication>
+#include <QEventLoop>
+#include <QStringList>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QtAlgorithms>
+#include <QGLFramebufferObject>
+
+#include "glwidget.h"
+#include "glcallcounter.h"
+
+#ifndef BASICGL_RESOURCE_DIR
+#define BASICGL_RESOURCE_DIR "resources"
+#endif
+
+//!Effects enabled during a benchmark scenario.
+struct Scenario{
+	const char *name;
+	bool lighting;
+	bool reflection;
+	bool fog;
+	bool texturing;
+};
+
+static const Scenario scenarios[] = {
+	{"plain",      false, false, false, false},
+	{"lighting",   true,  false, false, false},
+	{"reflection", false, true,  false, false},
+	{"fog",        false, false, true,  false},
+	{"textured",   false, false, false, true},
+	{"all",        true,  true,  true,  true}
+};
+
+//!Frame time statistics of a scenario.
+struct ScenarioResult{
+	QString name;
+	int frames;
+	double meanMs;
+	double p50Ms;
+	double p99Ms;
+	double fps;
+	double glCallsPerFrame;
+	double stateChangesFilteredPerFrame;
+	int instances;
+};
+
+//!Class BenchWidget.
+/*!
+ * GLWidget used by the benchmark. It gives access to the protected
+ * GL entry points so frames can be rendered without showing the widget.
+ */
+class BenchWidget: public GLWidget{
+
+  private:
+	QGLFramebufferObject *fbo;
+
+  public:
+	BenchWidget(): fbo(0){
+
+		//Setters must not render; frames are driven by renderFrame().
+		setUpdatesEnabled(false);
+	}
+
+	~BenchWidget(){
+
+		makeCurrent();
+		delete fbo;
+	}
+
+	bool initialize(int width, int height){
+
+		makeCurrent();
+		if(!isValid() || !QGLFramebufferObject::hasOpenGLFramebufferObjects())
+			return false;
+
+		fbo = new QGLFramebufferObject(width, height,
+									   QGLFramebufferObject::Depth);
+		if(!fbo->isValid())
+			return false;
+
+		fbo->bind();
+		glInit();
+		resizeGL(width, height);
+		return true;
+	}
+
+	void renderFrame(){
+
+		paintGL();
+		glFinish();
+	}
+};
+
+//!Class CaptureSink.
+/*!
+ * Frame consumer of --capture. It only reads the pixels, so the cost
+ * measured is that of the readback.
+ */
+class CaptureSink: public FrameConsumer{
+
+  public:
+	quint64 checksum;
+
+	CaptureSink(): checksum(0){}
+
+	void frameCaptured(const CapturedFrame &frame){
+
+		checksum += frame.pixels[(frame.height/2)*frame.bytesPerLine + frame.width*2];
+	}
+};
+
+/**
+ * @brief Percentile.
+ *
+ * @param sorted frame times sorted in ascending order.
+ * @param value the percentile to compute, between 0 and 100.
+ *
+ * @return the frame time at the requested percentile (nearest rank).
+ */
+static double percentile(const QVector<qint64> &sorted, double value){
+
+	int rank = (int)((value / 100.0) * sorted.size() + 0.5);
+	rank = qBound(1, rank, sorted.size());
+	return sorted[rank-1] / 1.0e6;
+}
+
+/**
+ * @brief Run scenario.
+ *
+ * Configures the effects of the scenario and renders the requested
+ * number of frames while the cube rotates around its three axes.
+ *
+ * @param widget the benchmark widget.
+ * @param scenario the effects to enable.
+ * @param frames number of measured frames.
+ * @param warmup number of frames rendered before measuring.
+ *
+ * @return the statistics of the measured frames.
+ */
+static ScenarioResult runScenario(BenchWidget &widget, const Scenario &scenario,
+								  int frames, int warmup){
+
+	QString resources(BASICGL_RESOURCE_DIR);
+
+	widget.setLighting(scenario.lighting);
+	widget.setReflection(scenario.reflection);
+	widget.setFog(scenario.fog);
+
+	if(scenario.texturing && QFileInfo(resources + "/cubeTexture.png").exists()
+	   && QFileInfo(resources + "/floor.png").exists()){
+		widget.enableCubeTexture(resources + "/cubeTexture.png");
+		widget.enableFloorTexture(resources + "/floor.png");
+
+		//Textures are decoded on worker threads; the first warmup frame
+		//uploads them once decoding has finished.
+		while(widget.texturesLoading())
+			QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+	}
+	else{
+		widget.disableCubeTexture();
+		widget.disableFloorTexture();
+	}
+
+	QVector<qint64> times;
+	unsigned long glCalls = 0;
+	quint64 stateChangesFiltered = 0;
+	QElapsedTimer timer;
+
+	for(int frame = -warmup; frame < frames; frame++){
+
+		//Scripted rotation, in 1/16 degree units as the mouse does.
+		widget.setXRotation((frame * 3 * 16) % (360 * 16) + 360 * 16);
+		widget.setYRotation((frame * 5 * 16) % (360 * 16) + 360 * 16);
+		widget.setZRotation((frame * 16) % (360 * 16) + 360 * 16);
+
+		glCallCounterReset();
+		timer.start();
+		widget.renderFrame();
+		qint64 elapsed = timer.nsecsElapsed();
+
+		if(frame >= 0){
+			times.append(elapsed);
+			glCalls += glCallCounterValue();
+			stateChangesFiltered += widget.stateChangesFiltered();
+		}
+	}
+
+	qint64 total = 0;
+	for(int i = 0; i < times.size(); i++)
+		total += times[i];
+	qSort(times.begin(), times.end());
+
+	ScenarioResult result;
+	result.name = scenario.name;
+	result.frames = frames;
+	result.meanMs = total / 1.0e6 / frames;
+	result.p50Ms = percentile(times, 50.0);
+	result.p99Ms = percentile(times, 99.0);
+	result.fps = total > 0 ? frames * 1.0e9 / total : 0.0;
+	//The programs are driven through entry points resolved at run time,
+	//which the linker cannot wrap, so their count would be misleading.
+	result.glCallsPerFrame = glCallCounterAvailable() && !widget.shadersEnabled() ?
+		(double)glCalls / frames : -1.0;
+	result.stateChangesFilteredPerFrame = (double)stateChangesFiltered / frames;
+	result.instances = widget.instances();
+	return result;
+}
+
+/**
+ * @brief Write results.
+ *
+ * Writes the benchmark results as a JSON document.
+ *
+ * @param out the stream to write to.
+ * @param width width of the rendered frames.
+ * @param height height of the rendered frames.
+ * @param widget the benchmark widget.
+ * @param results the statistics of every scenario.
+ */
+static void writeResults(QTextStream &out, int width, int height, const GLWidget &widget,
+						 const QList<ScenarioResult> &results){
+
+	out << "{\n";
+	out << "  \"vendor\": \"" << (const char *)glGetString(GL_VENDOR) << "\",\n";
+	out << "  \"renderer\": \"" << (const char *)glGetString(GL_RENDERER) << "\",\n";
+	out << "  \"version\": \"" << (const char *)glGetString(GL_VERSION) << "\",\n";
+	out << "  \"width\": " << width << ",\n";
+	out << "  \"height\": " << height << ",\n";
+	out << "  \"pipeline\": \"" << (widget.shadersEnabled() ? "glsl" : "fixed") << "\",\n";
+	if(widget.shadersEnabled())
+		out << "  \"gl_calls_note\": \"not counted: the GLSL pipeline calls entry points "
+			"resolved at run time, which the counter cannot see\",\n";
+	out << "  \"program_build_ms\": " << widget.programBuildTime() / 1.0e6 << ",\n";
+	out << "  \"program_cache_hits\": " << widget.programCacheHits() << ",\n";
+	out << "  \"program_cache_misses\": " << widget.programCacheMisses() << ",\n";
+	out << "  \"texture_cache_hits\": " << widget.textureCacheHits() << ",\n";
+	out << "  \"texture_cache_misses\": " << widget.textureCacheMisses() << ",\n";
+	out << "  \"frames_captured\": " << widget.framesCaptured() << ",\n";
+	out << "  \"frames_dropped\": " << widget.framesDropped() << ",\n";
+	out << "  \"scenarios\": [\n";
+
+	for(int i = 0; i < results.size(); i++){
+
+		const ScenarioResult &result = results[i];
+
+		out << "    {\"name\": \"" << result.name << "\"";
+		out << ", \"frames\": " << result.frames;
+		out << ", \"mean_ms\": " << result.meanMs;
+		out << ", \"p50_ms\": " << result.p50Ms;
+		out << ", \"p99_ms\": " << result.p99Ms;
+		out << ", \"fps\": " << result.fps;
+		out << ", \"gl_calls_per_frame\": ";
+		if(result.glCallsPerFrame < 0.0)
+			out << "null";
+		else
+			out << result.glCallsPerFrame;
+		out << ", \"state_changes_filtered_per_frame\": "
+			<< result.stateChangesFilteredPerFrame;
+		if(result.instances > 0){
+			out << ", \"instances\": " << result.instances;
+			out << ", \"instances_per_second\": " << result.instances * result.fps;
+		}
+		out << "}" << (i + 1 < results.size() ? ",\n" : "\n");
+	}
+
+	out << "  ]\n";
+	out << "}\n";
+}
+
+/**
+ * @brief Print usage.
+ *
+ */
+static void usage(){
+
+	QTextStream err(stderr);
+	err << "Usage: basicgl_bench [--frames N] [--warmup N] [--size WxH]"
+		<< " [--scenario NAME] [--instances N] [--texture-budget MB] [--capture]"
+		<< " [--fixed | --glsl]"
+		<< " [--output FILE]\n";
+}
+
+/**
+ * @brief Main
+ *
+ * Entry point of the benchmark.
+ *
+ * @param argc number of arguments.
+ * @param argv arguments array.
+ *
+ * @return 0 on success, 1 on bad arguments and 2 if no GL context
+ * with framebuffer objects could be created.
+ */
+int main(int argc, char *argv[]){
+
+	QApplication app(argc, argv);
+
+	int frames = 300;
+	int warmup = 10;
+	int width = 853;
+	int height = 480;
+	QString scenarioName;
+	QString outputFileName;
+	int instances = 0;
+	int textureBudget = -1;
+	bool capture = false;
+	//Call counts are only complete for the fixed function pipeline.
+	bool fixedFunction = glCallCounterAvailable();
+
+	QStringList args = app.arguments();
+	for(int i = 1; i < args.size(); i++){
+
+		bool ok = true;
+
+		if(args[i] == "--frames" && i + 1 < args.size())
+			frames = args[++i].toInt(&ok);
+		else if(args[i] == "--warmup" && i + 1 < args.size())
+			warmup = args[++i].toInt(&ok);
+		else if(args[i] == "--size" && i + 1 < args.size()){
+			QStringList size = args[++i].split('x');
+			ok = size.size() == 2;
+			if(ok)
+				width = size[0].toInt(&ok);
+			if(ok)
+				height = size[1].toInt(&ok);
+		}
+		else if(args[i] == "--scenario" && i + 1 < args.size())
+			scenarioName = args[++i];
+		else if(args[i] == "--instances" && i + 1 < args.size())
+			instances = args[++i].toInt(&ok);
+		else if(args[i] == "--texture-budget" && i + 1 < args.size()){
+			textureBudget = args[++i].toInt(&ok);
+			ok = ok && textureBudget >= 0;
+		}
+		else if(args[i] == "--capture")
+			capture = true;
+		else if(args[i] == "--fixed")
+			fixedFunction = true;
+		else if(args[i] == "--glsl")
+			fixedFunction = false;
+		else if(args[i] == "--output" && i + 1 < args.size())
+			outputFileName = args[++i];
+		else
+			ok = false;
+
+		if(!ok || frames <= 0 || warmup < 0 || width <= 0 || height <= 0
+		   || instances < 0){
+			usage();
+			return 1;
+		}
+	}
+
+	//Read by GLWidget when it is created.
+	qputenv("BASICGL_FIXED_FUNCTION", fixedFunction ? "1" : "");
+
+	BenchWidget widget;
+
+	if(!widget.initialize(width, height)){
+		QTextStream(stderr) << "basicgl_bench: no GL context with "
+							<< "framebuffer objects available\n";
+		return 2;
+	}
+
+	widget.setCubeRedComponent(200);
+	widget.setCubeGreenComponent(80);
+	widget.setCubeBlueComponent(40);
+	widget.setAmbientLightRedComponent(64);
+	widget.setAmbientLightGreenComponent(64);
+	widget.setAmbientLightBlueComponent(64);
+	widget.setDiffuseLightRedComponent(220);
+	widget.setDiffuseLightGreenComponent(220);
+	widget.setDiffuseLightBlueComponent(220);
+	widget.setFogRedComponent(128);
+	widget.setFogGreenComponent(128);
+	widget.setFogBlueComponent(140);
+	widget.setFogStart(40);
+	widget.setFogEnd(250);
+	widget.setInstances(instances);
+	if(textureBudget >= 0)
+		widget.setTextureCacheBudget(textureBudget*1024LL*1024LL);
+
+	CaptureSink sink;
+	if(capture)
+		widget.addFrameConsumer(&sink);
+
+	QList<ScenarioResult> results;
+	int scenarioCount = sizeof(scenarios) / sizeof(scenarios[0]);
+	for(int i = 0; i < scenarioCount; i++){
+		if(scenarioName.isEmpty() || scenarioName == scenarios[i].name)
+			results.append(runScenario(widget, scenarios[i], frames, warmup));
+	}
+
+	if(capture){
+		widget.flushCapture();
+		widget.removeFrameConsumer(&sink);
+	}
+
+	if(results.isEmpty()){
+		usage();
+		return 1;
+	}
+
+	if(outputFileName.isEmpty()){
+		QTextStream out(stdout);
+		writeResults(out, width, height, widget, results);
+	}
+	else{
+		QFile file(outputFileName);
+		if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate)){
+			QTextStream(stderr) << "basicgl_bench: cannot write "
+								<< outputFileName << "\n";
+			return 1;
+		}
+		QTextStream out(&file);
+		writeResults(out, width, height, widget, results);
+	}
+
+	return 0;
+}
@@ -32,13 +32,18 @@
 #include "centralwidget.h"
 
 #include <QGridLayout>
+#include <QHBoxLayout>
 #include <QTabWidget>
+#include <QSpinBox>
+#include <QLabel>
+#include <QPushButton>
 
 #include "glwidget.h"
 #include "colorwidget.h"
 #include "lightingwidget.h"
 #include "texturewidget.h"
 #include "fxwidget.h"
+#include "videorecorder.h"
 
 /** 
 
@@ -55,37 +60,30 @@ CentralWidget::CentralWidget(QWidget *parent):QWidget(parent){
 
 	glWidget = new GLWidget;
 	tabWidget = new QTabWidget;
+	recorder = 0;
 	colorWidget = new ColorWidget;
 	lightingWidget = new LightingWidget;
 	textureWidget = new TextureWidget;
 	fxWidget = new FXWidget;
-	
-	connect(colorWidget,SIGNAL(redChanged(int)),
-			glWidget,SLOT(setCubeRedComponent(int)));
-
-	connect(colorWidget,SIGNAL(greenChanged(int)),
-			glWidget,SLOT(setCubeGreenComponent(int)));
-
-	connect(colorWidget,SIGNAL(blueChanged(int)),
-			glWidget,SLOT(setCubeBlueComponent(int)));
-
-	connect(lightingWidget,SIGNAL(ambientLightRedChanged(int)),
-			glWidget,SLOT(setAmbientLightRedComponent(int)));
 
-	connect(lightingWidget,SIGNAL(ambientLightGreenChanged(int)),
-			glWidget,SLOT(setAmbientLightGreenComponent(int)));
+	instancesSpinBox = new QSpinBox;
+	instancesSpinBox->setRange(0, 1000000);
+	instancesSpinBox->setSingleStep(1000);
+	instancesSpinBox->setSpecialValueText("Single cube");
+	throughputLabel = new QLabel;
 
-	connect(lightingWidget,SIGNAL(ambientLightBlueChanged(int)),
-			glWidget,SLOT(setAmbientLightBlueComponent(int)));
-
-	connect(lightingWidget,SIGNAL(diffuseLightRedChanged(int)),
-			glWidget,SLOT(setDiffuseLightRedComponent(int)));
+	//Only shown while recording.
+	stopRecordingButton = new QPushButton("Stop recording");
+	stopRecordingButton->hide();
+	
+	connect(colorWidget,SIGNAL(colorChanged(int,int,int)),
+			glWidget,SLOT(setCubeColor(int,int,int)));
 
-	connect(lightingWidget,SIGNAL(diffuseLightGreenChanged(int)),
-			glWidget,SLOT(setDiffuseLightGreenComponent(int)));
+	connect(lightingWidget,SIGNAL(ambientLightChanged(int,int,int)),
+			glWidget,SLOT(setAmbientLight(int,int,int)));
 
-	connect(lightingWidget,SIGNAL(diffuseLightBlueChanged(int)),
-			glWidget,SLOT(setDiffuseLightBlueComponent(int)));
+	connect(lightingWidget,SIGNAL(diffuseLightChanged(int,int,int)),
+			glWidget,SLOT(setDiffuseLight(int,int,int)));
 
 	connect(lightingWidget,SIGNAL(setLighting(bool)),
 			glWidget,SLOT(setLighting(bool)));
@@ -114,20 +112,23 @@ CentralWidget::CentralWidget(QWidget *parent):QWidget(parent){
 	connect(fxWidget, SIGNAL(setFog(bool)),
 			glWidget, SLOT(setFog(bool)));
 
-	connect(fxWidget, SIGNAL(fogRedChanged(int)),
-			glWidget, SLOT(setFogRedComponent(int)));
-
-	connect(fxWidget, SIGNAL(fogGreenChanged(int)),
-			glWidget, SLOT(setFogGreenComponent(int)));
-
-	connect(fxWidget, SIGNAL(fogBlueChanged(int)),
-			glWidget, SLOT(setFogBlueComponent(int)));
+	connect(fxWidget, SIGNAL(fogColorChanged(int,int,int)),
+			glWidget, SLOT(setFogColor(int,int,int)));
 
 	connect(fxWidget, SIGNAL(fogStartChanged(int)),
 			glWidget, SLOT(setFogStart(int)));
 
 	connect(fxWidget, SIGNAL(fogEndChanged(int)),
 			glWidget, SLOT(setFogEnd(int)));
+
+	connect(instancesSpinBox, SIGNAL(valueChanged(int)),
+			glWidget, SLOT(setInstances(int)));
+
+	connect(glWidget, SIGNAL(instanceThroughputChanged(double)),
+			this, SLOT(updateThroughput(double)));
+
+	connect(stopRecordingButton, SIGNAL(clicked()),
+			this, SLOT(stopRecording()));
 		
 	tabWidget->addTab(colorWidget, "Color");
 	tabWidget->addTab(lightingWidget, "Lighting");
@@ -141,7 +142,101 @@ CentralWidget::CentralWidget(QWidget *parent):QWidget(parent){
 	layout->addWidget(glWidget,0,0);
 	layout->addWidget(tabWidget,0,1);
 	layout->addWidget(textureWidget,1,0,1,2);
+
+	QHBoxLayout *instancesLayout = new QHBoxLayout;
+	instancesLayout->addWidget(new QLabel("Instances:"));
+	instancesLayout->addWidget(instancesSpinBox);
+	instancesLayout->addWidget(throughputLabel);
+	instancesLayout->addStretch();
+	instancesLayout->addWidget(stopRecordingButton);
+	layout->addLayout(instancesLayout,2,0,1,2);
 		
 	setLayout(layout);
 }
 
+/** 
+ * @brief Destructor.
+ *
+ * Stops the recording, if any.
+ * 
+ */
+CentralWidget::~CentralWidget(){
+
+	if(recorder){
+		glWidget->removeFrameConsumer(recorder);
+		delete recorder;
+	}
+}
+
+/** 
+ * @brief Set instances.
+ *
+ * Sets the number of cubes of the stress lattice, as if it had been
+ * entered in the instances control.
+ * 
+ * @param count number of cubes, 0 for the single cube.
+ */
+void CentralWidget::setInstances(int count){
+
+	instancesSpinBox->setValue(count);
+}
+
+/** 
+ * @brief Update throughput.
+ *
+ * Shows the number of cubes drawn per second by the stress lattice.
+ * 
+ * @param instancesPerSecond the throughput measured by the GLWidget.
+ */
+void CentralWidget::updateThroughput(double instancesPerSecond){
+
+	if(instancesSpinBox->value() == 0)
+		throughputLabel->clear();
+	else
+		throughputLabel->setText(QString("%1 instances/s")
+								 .arg(instancesPerSecond, 0, 'f', 0));
+}
+
+
+/** 
+ * @brief Start recording.
+ *
+ * Records the view until stopRecording() or until the widget is
+ * destroyed. See VideoRecorder.
+ * 
+ * @param fileName the file to record to, *.y4m for Y4M and raw RGBA
+ * otherwise.
+ *
+ * @return false if the file cannot be created.
+ */
+bool CentralWidget::startRecording(const QString &fileName){
+
+	if(!recorder)
+		recorder = new VideoRecorder;
+	else
+		glWidget->removeFrameConsumer(recorder);
+
+	if(!recorder->startRecording(fileName))
+		return false;
+
+	glWidget->addFrameConsumer(recorder);
+	stopRecordingButton->show();
+	return true;
+}
+
+/** 
+ * @brief Stop recording.
+ *
+ * Closes the file being recorded. Frames still being read back are not
+ * recorded.
+ * 
+ */
+void CentralWidget::stopRecording(){
+
+	if(!recorder)
+		return;
+
+	glWidget->removeFrameConsumer(recorder);
+	recorder->stopRecording();
+	stopRecordingButton->hide();
+}
@@ -41,6 +41,10 @@ class ColorWidget;
 class LightingWidget;
 class TextureWidget;
 class FXWidget;
+class QSpinBox;
+class QLabel;
+class QPushButton;
+class VideoRecorder;
 
 //!CentralWidget
 class CentralWidget: public QWidget{
@@ -54,9 +58,20 @@ private:
 	LightingWidget *lightingWidget;	
 	TextureWidget *textureWidget;
 	FXWidget *fxWidget;
+	QSpinBox *instancesSpinBox;
+	QLabel *throughputLabel;
+	QPushButton *stopRecordingButton;
+	VideoRecorder *recorder;
 	
 public:
 	CentralWidget(QWidget *parent=0);
+	~CentralWidget();
+	void setInstances(int count);
+	bool startRecording(const QString &fileName);
+
+public slots:
+	void updateThroughput(double instancesPerSecond);
+	void stopRecording();
 	
 	
 }; //END class CentralWidget
@@ -100,7 +100,7 @@ QSlider *ColorWidget::createSlider(){
 void ColorWidget::updateRed(int value){
 
 	redValueLabel->setNum(value);
-	emit redChanged(value);
+	emit colorChanged(value, greenSlider->value(), blueSlider->value());
 }
 
 /** 
@@ -111,7 +111,7 @@ void ColorWidget::updateRed(int value){
 void ColorWidget::updateGreen(int value){
 
 	greenValueLabel->setNum(value);
-	emit greenChanged(value);
+	emit colorChanged(redSlider->value(), value, blueSlider->value());
 }
 
 /** 
@@ -122,5 +122,5 @@ void ColorWidget::updateGreen(int value){
 void ColorWidget::updateBlue(int value){
 
 	blueValueLabel->setNum(value);
-	emit blueChanged(value);
+	emit colorChanged(redSlider->value(), greenSlider->value(), value);
 }
@@ -62,9 +62,7 @@ class ColorWidget: public QWidget{
 	void updateBlue(int newValue);	
 
   signals:
-   	void redChanged(int newValue);   //!< Emmited when red value has changed.
-	void greenChanged(int newValue); //!< Emmited when green value has changed.
-	void blueChanged(int newValue);  //!< Emmited when blue value has changed.
+	void colorChanged(int red, int green, int blue); //!< Emmited when any component has changed.
 
 }; //END class ColorWidget
 
@@ -0,0 +1,374 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   framecapture.cpp
+ * @author Rafael Palomar
+ * @date   Mon Jun 21 10:12:48 2010
+ *
+ * @brief  FrameCapture class definition.
+ *
+ * This file contains the definition of the FrameCapture class.
+ *
+ */
+
+#include "framecapture.h"
+
+#ifndef GL_BGRA
+#define GL_BGRA 0x80E1
+#endif
+
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#endif
+
+#ifndef GL_SYNC_FLUSH_COMMANDS_BIT
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#endif
+
+#ifndef GL_ALREADY_SIGNALED
+#define GL_ALREADY_SIGNALED 0x911A
+#endif
+
+#ifndef GL_CONDITION_SATISFIED
+#define GL_CONDITION_SATISFIED 0x911C
+#endif
+
+//!Longest wait for a fence on flush(), in ns.
+static const quint64 flushTimeout = 1000000000ULL;
+
+/**
+ * @brief Default constructor.
+ *
+ * The capture starts without consumers, so no frame is read back.
+ */
+FrameCapture::FrameCapture(){
+
+	pixelBuffers = false;
+	dropFrames = true;
+	fenceSync = 0;
+	clientWaitSync = 0;
+	deleteSync = 0;
+	writeSlot = 0;
+	readSlot = 0;
+	width = 0;
+	height = 0;
+	frameNumber = 0;
+	captured = 0;
+	dropped = 0;
+	clock.start();
+
+	for(int i = 0; i < ringSize; i++){
+		ring[i].buffer = QGLBuffer(QGLBuffer::PixelPackBuffer);
+		ring[i].fence = 0;
+		ring[i].inFlight = false;
+		ring[i].width = 0;
+		ring[i].height = 0;
+		ring[i].number = 0;
+		ring[i].time = 0;
+	}
+}
+
+/**
+ * @brief Destructor.
+ *
+ * Frames still in flight are discarded. The GL context must be current.
+ */
+FrameCapture::~FrameCapture(){
+
+	for(int i = 0; i < ringSize; i++)
+		if(ring[i].fence)
+			deleteSync(ring[i].fence);
+}
+
+/**
+ * @brief Initialize.
+ *
+ * Creates the pixel buffers and resolves the ARB_sync entry points.
+ * Must be called with the context current.
+ *
+ * @param context the GL context of the frames.
+ */
+void FrameCapture::initialize(const QGLContext *context){
+
+	QByteArray extensions((const char *)glGetString(GL_EXTENSIONS));
+
+	if(extensions.contains("GL_ARB_sync")){
+		fenceSync = (FenceSync)context->getProcAddress("glFenceSync");
+		clientWaitSync = (ClientWaitSync)context->getProcAddress("glClientWaitSync");
+		deleteSync = (DeleteSync)context->getProcAddress("glDeleteSync");
+	}
+
+	if(!fenceSync || !clientWaitSync || !deleteSync){
+		fenceSync = 0;
+		clientWaitSync = 0;
+		deleteSync = 0;
+	}
+
+	pixelBuffers = (QGLFormat::openGLVersionFlags() & QGLFormat::OpenGL_Version_2_1);
+	for(int i = 0; i < ringSize && pixelBuffers; i++){
+		pixelBuffers = ring[i].buffer.create();
+		ring[i].buffer.setUsagePattern(QGLBuffer::StreamRead);
+	}
+}
+
+/**
+ * @brief Resize.
+ *
+ * Sets the size of the next frames. Frames in flight keep their size.
+ *
+ * @param newWidth width of the frames.
+ * @param newHeight height of the frames.
+ */
+void FrameCapture::resize(int newWidth, int newHeight){
+
+	width = newWidth;
+	height = newHeight;
+}
+
+/**
+ * @brief Set frame dropping.
+ *
+ * @param enable whether a frame is dropped when the ring is full, rather
+ * than waiting for the oldest frame in flight.
+ */
+void FrameCapture::setFrameDropping(bool enable){
+
+	dropFrames = enable;
+}
+
+/**
+ * @brief Add consumer.
+ *
+ * Frames are read back while there is a consumer.
+ *
+ * @param consumer receives every frame captured from now on.
+ */
+void FrameCapture::addConsumer(FrameConsumer *consumer){
+
+	QMutexLocker locker(&consumersMutex);
+	if(!consumers.contains(consumer))
+		consumers.append(consumer);
+}
+
+/**
+ * @brief Remove consumer.
+ *
+ * Waits for a frame being delivered, so the consumer can be destroyed
+ * once this returns.
+ *
+ * @param consumer a consumer added with addConsumer().
+ */
+void FrameCapture::removeConsumer(FrameConsumer *consumer){
+
+	QMutexLocker locker(&consumersMutex);
+	consumers.removeAll(consumer);
+}
+
+/**
+ * @brief Active.
+ *
+ * @return true if there is a consumer, so frames are read back.
+ */
+bool FrameCapture::isActive(){
+
+	QMutexLocker locker(&consumersMutex);
+	return !consumers.isEmpty();
+}
+
+/**
+ * @brief Ready.
+ *
+ * @param slot a slot in flight.
+ * @param wait whether to wait for the GL to finish the readback.
+ *
+ * @return true if the pixels of the slot can be mapped without stalling.
+ */
+bool FrameCapture::isReady(Slot &slot, bool wait){
+
+	//Without fences, a buffer is ready once the ring has gone round.
+	if(!slot.fence)
+		return wait || slot.number + ringSize <= frameNumber;
+
+	GLenum result = clientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+								   wait ? flushTimeout : 0);
+	return result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED;
+}
+
+/**
+ * @brief Deliver.
+ *
+ * Maps the pixels of a slot, hands them to the consumers and frees the
+ * slot.
+ *
+ * @param slot a slot whose readback has finished.
+ */
+void FrameCapture::deliver(Slot &slot){
+
+	if(slot.fence){
+		deleteSync(slot.fence);
+		slot.fence = 0;
+	}
+	slot.inFlight = false;
+
+	slot.buffer.bind();
+	const uchar *pixels = (const uchar *)slot.buffer.map(QGLBuffer::ReadOnly);
+
+	if(pixels){
+		CapturedFrame frame = {pixels, slot.width, slot.height, slot.width*4,
+							   slot.number, slot.time};
+
+		QMutexLocker locker(&consumersMutex);
+		for(int i = 0; i < consumers.size(); i++)
+			consumers[i]->frameCaptured(frame);
+		captured++;
+
+		slot.buffer.unmap();
+	}
+	else
+		dropped++;
+
+	slot.buffer.release();
+}
+
+/**
+ * @brief Collect.
+ *
+ * Delivers the frames in flight whose readback has finished, oldest
+ * first.
+ *
+ * @param wait whether to wait for all of them.
+ */
+void FrameCapture::collect(bool wait){
+
+	while(ring[readSlot].inFlight && isReady(ring[readSlot], wait)){
+		deliver(ring[readSlot]);
+		readSlot = (readSlot + 1) % ringSize;
+	}
+}
+
+/**
+ * @brief Capture frame.
+ *
+ * Delivers the earlier frames that are ready and starts reading back the
+ * frame just rendered from the current read buffer. Called after every
+ * frame; it does nothing while there are no consumers and nothing is in
+ * flight.
+ */
+void FrameCapture::captureFrame(){
+
+	frameNumber++;
+
+	if(pixelBuffers)
+		collect(false);
+
+	if(width <= 0 || height <= 0 || !isActive())
+		return;
+
+	if(!pixelBuffers){
+		syncPixels.resize(width*height*4);
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		glReadPixels(0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE, syncPixels.data());
+
+		CapturedFrame frame = {(const uchar *)syncPixels.constData(), width, height,
+							   width*4, frameNumber - 1, clock.nsecsElapsed()};
+
+		QMutexLocker locker(&consumersMutex);
+		for(int i = 0; i < consumers.size(); i++)
+			consumers[i]->frameCaptured(frame);
+		captured++;
+		return;
+	}
+
+	Slot &slot = ring[writeSlot];
+
+	//The GPU is a whole ring behind; waiting would stall the frame.
+	if(slot.inFlight && dropFrames){
+		dropped++;
+		return;
+	}
+
+	//A full ring is read from the slot to be written next.
+	if(slot.inFlight){
+		isReady(slot, true);
+		deliver(slot);
+		readSlot = (readSlot + 1) % ringSize;
+	}
+
+	slot.buffer.bind();
+	if(slot.width != width || slot.height != height){
+		slot.buffer.allocate(width*height*4);
+		slot.width = width;
+		slot.height = height;
+	}
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE, 0);
+	slot.buffer.release();
+
+	if(fenceSync)
+		slot.fence = fenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.inFlight = true;
+	slot.number = frameNumber - 1;
+	//Stamped now rather than on delivery, so consumers get render times.
+	slot.time = clock.nsecsElapsed();
+
+	writeSlot = (writeSlot + 1) % ringSize;
+}
+
+/**
+ * @brief Flush.
+ *
+ * Waits for the frames in flight and delivers them, e.g. before the
+ * last consumer is removed. The GL context must be current.
+ */
+void FrameCapture::flush(){
+
+	collect(true);
+}
+
+/**
+ * @brief Pixel buffers.
+ *
+ * @return true if frames are read back asynchronously.
+ */
+bool FrameCapture::hasPixelBuffers() const{
+
+	return pixelBuffers;
+}
+
+/**
+ * @brief Frames captured.
+ *
+ * @return the number of frames delivered to the consumers.
+ */
+quint64 FrameCapture::framesCaptured() const{
+
+	return captured;
+}
+
+/**
+ * @brief Frames dropped.
+ *
+ * @return the number of frames not captured because the ring was full.
+ */
+quint64 FrameCapture::framesDropped() const{
+
+	return dropped;
+}
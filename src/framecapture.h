@@ -0,0 +1,150 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   framecapture.h
+ * @author Rafael Palomar
+ * @date   Mon Jun 21 10:12:48 2010
+ *
+ * @brief  FrameCapture class header.
+ *
+ * This file contains the declaration of the class FrameCapture and of
+ * the FrameConsumer interface.
+ *
+ */
+
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QMutex>
+#include <QtOpenGL>
+#include <QGLBuffer>
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+//!Pixels of a captured frame.
+/*!
+ * BGRA bytes (QImage::Format_RGB32 on little endian machines), with the
+ * bottom row first, as the GL reads them.
+ */
+struct CapturedFrame{
+	const uchar *pixels;  //!< Only valid during FrameConsumer::frameCaptured().
+	int width;
+	int height;
+	int bytesPerLine;
+	quint64 number;       //!< Frames rendered before this one.
+	qint64 time;          //!< When it was rendered (not read back), in ns since the capture started.
+};
+
+//!Interface FrameConsumer.
+/*!
+ * Receives the frames captured by a GLWidget. The pixels are those of
+ * the mapped pixel buffer, so they must be copied if kept after
+ * frameCaptured() returns. It is called on the thread rendering the
+ * frames, a few frames after the frame was rendered.
+ */
+class FrameConsumer{
+
+  public:
+	virtual ~FrameConsumer(){}
+	virtual void frameCaptured(const CapturedFrame &frame) = 0;
+
+}; //END class FrameConsumer.
+
+//!Class FrameCapture.
+/*!
+ * Reads frames back through a ring of pixel buffer objects. Each frame is
+ * read into a buffer with a fence behind it, and handed to the consumers
+ * once the fence has signaled, so the readback of a frame overlaps the
+ * rendering of the next ones instead of stalling the GL. If the GPU is
+ * so far behind that the whole ring is in flight, the frame is dropped
+ * rather than waited for, unless frame dropping is disabled for offline
+ * rendering.
+ *
+ * Without ARB_sync a buffer is assumed ready after the ring has gone
+ * round; without pixel buffer objects frames are read synchronously.
+ */
+class FrameCapture{
+
+  private:
+	typedef void *(APIENTRY *FenceSync)(GLenum condition, GLbitfield flags);
+	typedef GLenum (APIENTRY *ClientWaitSync)(void *sync, GLbitfield flags, quint64 timeout);
+	typedef void (APIENTRY *DeleteSync)(void *sync);
+
+	//!Frames whose readback may still be in flight.
+	static const int ringSize = 3;
+
+	//!A pixel buffer of the ring.
+	struct Slot{
+		QGLBuffer buffer;
+		void *fence;
+		bool inFlight;
+		int width;
+		int height;
+		quint64 number;
+		qint64 time;
+	};
+
+	bool pixelBuffers;
+	bool dropFrames;
+	FenceSync fenceSync;
+	ClientWaitSync clientWaitSync;
+	DeleteSync deleteSync;
+	Slot ring[ringSize];
+	int writeSlot;
+	int readSlot;
+	int width;
+	int height;
+	quint64 frameNumber;
+	QElapsedTimer clock;
+	quint64 captured;
+	quint64 dropped;
+	QByteArray syncPixels;
+	QMutex consumersMutex;
+	QList<FrameConsumer *> consumers;
+
+	bool isReady(Slot &slot, bool wait);
+	void deliver(Slot &slot);
+	void collect(bool wait);
+
+  public:
+	FrameCapture();
+	~FrameCapture();
+
+	void initialize(const QGLContext *context);
+	void resize(int width, int height);
+	void setFrameDropping(bool enable);
+	void addConsumer(FrameConsumer *consumer);
+	void removeConsumer(FrameConsumer *consumer);
+	bool isActive();
+
+	void captureFrame();
+	void flush();
+
+	bool hasPixelBuffers() const;
+	quint64 framesCaptured() const;
+	quint64 framesDropped() const;
+
+}; //END class FrameCapture.
+
+#endif
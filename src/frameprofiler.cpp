@@ -0,0 +1,328 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   frameprofiler.cpp
+ * @author Rafael Palomar
+ * @date   Fri May 28 16:40:02 2010
+ *
+ * @brief  FrameProfiler class definition.
+ *
+ * This file contains the definition of the FrameProfiler class.
+ *
+ */
+
+#include "frameprofiler.h"
+
+#include <QTextStream>
+
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED 0x88BF
+#endif
+
+#ifndef GL_QUERY_RESULT
+#define GL_QUERY_RESULT 0x8866
+#endif
+
+#ifndef GL_QUERY_RESULT_AVAILABLE
+#define GL_QUERY_RESULT_AVAILABLE 0x8867
+#endif
+
+/**
+ * @brief Default constructor.
+ *
+ * The profiler starts disabled and without GPU timers.
+ */
+FrameProfiler::FrameProfiler(){
+
+	enabled = false;
+	gpuTimers = false;
+	genQueries = 0;
+	beginQuery = 0;
+	endQuery = 0;
+	getQueryObjectiv = 0;
+	getQueryObjectui64v = 0;
+	frameSlot = 0;
+	currentPass = -1;
+	cpuFrames = 0;
+	gpuFrames = 0;
+
+	for(int pass = 0; pass < PassCount; pass++){
+		cpuTotal[pass] = 0;
+		gpuTotal[pass] = 0;
+		cpuAverage[pass] = 0.0;
+		gpuAverage[pass] = -1.0;
+		for(int slot = 0; slot < framesInFlight; slot++){
+			queries[slot][pass] = 0;
+			queriesIssued[slot][pass] = false;
+		}
+	}
+}
+
+/**
+ * @brief Initialize.
+ *
+ * Resolves the timer query entry points (ARB or EXT timer query) and
+ * creates the queries. Must be called with the context current.
+ *
+ * @param context the GL context of the frames.
+ */
+void FrameProfiler::initialize(const QGLContext *context){
+
+	QByteArray extensions((const char *)glGetString(GL_EXTENSIONS));
+	bool arbTimers = extensions.contains("GL_ARB_timer_query");
+	bool extTimers = extensions.contains("GL_EXT_timer_query");
+
+	genQueries = (GenQueries)context->getProcAddress("glGenQueries");
+	beginQuery = (BeginQuery)context->getProcAddress("glBeginQuery");
+	endQuery = (EndQuery)context->getProcAddress("glEndQuery");
+	getQueryObjectiv = (GetQueryObjectiv)context->getProcAddress("glGetQueryObjectiv");
+	getQueryObjectui64v = (GetQueryObjectui64v)context->getProcAddress(
+		arbTimers ? "glGetQueryObjectui64v" : "glGetQueryObjectui64vEXT");
+
+	gpuTimers = (arbTimers || extTimers) && genQueries && beginQuery && endQuery
+		&& getQueryObjectiv && getQueryObjectui64v;
+
+	if(gpuTimers)
+		genQueries(framesInFlight*PassCount, &queries[0][0]);
+}
+
+/**
+ * @brief Set enabled.
+ *
+ * Must not be called between beginFrame() and endFrame().
+ *
+ * @param enable whether frames are profiled.
+ */
+void FrameProfiler::setEnabled(bool enable){
+
+	enabled = enable;
+	cpuFrames = 0;
+	gpuFrames = 0;
+	for(int pass = 0; pass < PassCount; pass++){
+		cpuTotal[pass] = 0;
+		gpuTotal[pass] = 0;
+	}
+	reportClock.start();
+}
+
+/**
+ * @brief Enabled.
+ *
+ * @return true if frames are profiled.
+ */
+bool FrameProfiler::isEnabled() const{
+
+	return enabled;
+}
+
+/**
+ * @brief GPU timers.
+ *
+ * @return true if the GL has timer queries.
+ */
+bool FrameProfiler::hasGpuTimers() const{
+
+	return gpuTimers;
+}
+
+/**
+ * @brief Begin frame.
+ *
+ * Collects the GPU times of the frame rendered framesInFlight frames ago
+ * and reuses its queries.
+ *
+ */
+void FrameProfiler::beginFrame(){
+
+	if(!enabled)
+		return;
+
+	frameSlot = (frameSlot + 1) % framesInFlight;
+	if(gpuTimers)
+		collect(frameSlot);
+
+	currentPass = -1;
+}
+
+/**
+ * @brief Begin pass.
+ *
+ * Ends the current pass, if any, and starts timing the next one.
+ *
+ * @param pass the pass that starts.
+ */
+void FrameProfiler::beginPass(Pass pass){
+
+	if(!enabled)
+		return;
+
+	if(currentPass >= 0){
+		cpuTotal[currentPass] += passClock.nsecsElapsed();
+		if(gpuTimers)
+			endQuery(GL_TIME_ELAPSED);
+	}
+
+	currentPass = pass;
+
+	if(gpuTimers){
+		beginQuery(GL_TIME_ELAPSED, queries[frameSlot][pass]);
+		queriesIssued[frameSlot][pass] = true;
+	}
+
+	passClock.start();
+}
+
+/**
+ * @brief End frame.
+ *
+ * Ends the last pass and prints the averages once per second.
+ *
+ */
+void FrameProfiler::endFrame(){
+
+	if(!enabled || currentPass < 0)
+		return;
+
+	cpuTotal[currentPass] += passClock.nsecsElapsed();
+	if(gpuTimers)
+		endQuery(GL_TIME_ELAPSED);
+
+	currentPass = -1;
+	cpuFrames++;
+
+	if(reportClock.elapsed() >= 1000)
+		report();
+}
+
+/**
+ * @brief CPU milliseconds.
+ *
+ * @param pass a pass.
+ *
+ * @return the average CPU time of the pass over the last report.
+ */
+double FrameProfiler::cpuMilliseconds(Pass pass) const{
+
+	return cpuAverage[pass];
+}
+
+/**
+ * @brief GPU milliseconds.
+ *
+ * @param pass a pass.
+ *
+ * @return the average GPU time of the pass over the last report, or a
+ * negative value if it is unknown.
+ */
+double FrameProfiler::gpuMilliseconds(Pass pass) const{
+
+	return gpuAverage[pass];
+}
+
+/**
+ * @brief Pass name.
+ *
+ * @param pass a pass.
+ *
+ * @return the name of the pass.
+ */
+const char *FrameProfiler::passName(Pass pass){
+
+	static const char *names[PassCount] = {
+		"clear", "reflection", "cube", "floor", "blend"
+	};
+
+	return names[pass];
+}
+
+/**
+ * @brief Collect.
+ *
+ * Adds the GPU times of a frame to the totals. Queries still in flight
+ * are not waited for: the whole frame is dropped from the GPU averages.
+ *
+ * @param slot the frame slot to collect.
+ */
+void FrameProfiler::collect(int slot){
+
+	bool issued = false;
+	bool available = true;
+
+	for(int pass = 0; pass < PassCount; pass++){
+		if(!queriesIssued[slot][pass])
+			continue;
+
+		GLint ready = 0;
+		getQueryObjectiv(queries[slot][pass], GL_QUERY_RESULT_AVAILABLE, &ready);
+		issued = true;
+		available = available && ready;
+	}
+
+	if(issued && available){
+		for(int pass = 0; pass < PassCount; pass++){
+			if(!queriesIssued[slot][pass])
+				continue;
+
+			quint64 elapsed = 0;
+			getQueryObjectui64v(queries[slot][pass], GL_QUERY_RESULT, &elapsed);
+			gpuTotal[pass] += elapsed;
+		}
+		gpuFrames++;
+	}
+
+	for(int pass = 0; pass < PassCount; pass++)
+		queriesIssued[slot][pass] = false;
+}
+
+/**
+ * @brief Report.
+ *
+ * Computes the averages since the last report and prints them to stderr.
+ *
+ */
+void FrameProfiler::report(){
+
+	QTextStream err(stderr);
+	err.setRealNumberPrecision(3);
+	err.setRealNumberNotation(QTextStream::FixedNotation);
+
+	err << "frame profile, " << cpuFrames << " frames (cpu/gpu ms):";
+
+	for(int pass = 0; pass < PassCount; pass++){
+
+		cpuAverage[pass] = cpuFrames ? cpuTotal[pass]/1.0e6/cpuFrames : 0.0;
+		gpuAverage[pass] = gpuFrames ? gpuTotal[pass]/1.0e6/gpuFrames : -1.0;
+
+		err << " " << passName((Pass)pass) << " " << cpuAverage[pass] << "/";
+		if(gpuAverage[pass] < 0.0)
+			err << "n/a";
+		else
+			err << gpuAverage[pass];
+
+		cpuTotal[pass] = 0;
+		gpuTotal[pass] = 0;
+	}
+
+	err << "\n";
+
+	cpuFrames = 0;
+	gpuFrames = 0;
+	reportClock.start();
+}
@@ -0,0 +1,114 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   frameprofiler.h
+ * @author Rafael Palomar
+ * @date   Fri May 28 16:08:44 2010
+ *
+ * @brief  FrameProfiler class header.
+ *
+ * This file contains the declaration of the class FrameProfiler.
+ *
+ */
+
+#ifndef FRAMEPROFILER_H
+#define FRAMEPROFILER_H
+
+#include <QElapsedTimer>
+#include <QtOpenGL>
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+//!Class FrameProfiler.
+/*!
+ * Splits every frame into passes and times them on the CPU and, when the
+ * GL has timer queries, on the GPU. Query results are read a few frames
+ * later, once they are available, so profiling never stalls the GL.
+ *
+ * Averages are printed to stderr once per second.
+ */
+class FrameProfiler{
+
+  public:
+	//!Passes of a frame.
+	enum Pass{
+		Clear,       //!< Texture uploads, clear and camera.
+		Reflection,  //!< Mirrored cube.
+		Cube,        //!< Cube.
+		Floor,       //!< Floor geometry.
+		Blend,       //!< Blending and transform setup of the floor.
+		PassCount
+	};
+
+  private:
+	typedef void (APIENTRY *GenQueries)(GLsizei n, GLuint *ids);
+	typedef void (APIENTRY *BeginQuery)(GLenum target, GLuint id);
+	typedef void (APIENTRY *EndQuery)(GLenum target);
+	typedef void (APIENTRY *GetQueryObjectiv)(GLuint id, GLenum name, GLint *params);
+	typedef void (APIENTRY *GetQueryObjectui64v)(GLuint id, GLenum name, quint64 *params);
+
+	//!Frames whose queries may still be in flight.
+	static const int framesInFlight = 4;
+
+	bool enabled;
+	bool gpuTimers;
+	GenQueries genQueries;
+	BeginQuery beginQuery;
+	EndQuery endQuery;
+	GetQueryObjectiv getQueryObjectiv;
+	GetQueryObjectui64v getQueryObjectui64v;
+	GLuint queries[framesInFlight][PassCount];
+	bool queriesIssued[framesInFlight][PassCount];
+	int frameSlot;
+	int currentPass;
+	QElapsedTimer passClock;
+	QElapsedTimer reportClock;
+	qint64 cpuTotal[PassCount];
+	quint64 gpuTotal[PassCount];
+	int cpuFrames;
+	int gpuFrames;
+	double cpuAverage[PassCount];
+	double gpuAverage[PassCount];
+
+	void collect(int slot);
+	void report();
+
+  public:
+	FrameProfiler();
+
+	void initialize(const QGLContext *context);
+	void setEnabled(bool enable);
+	bool isEnabled() const;
+	bool hasGpuTimers() const;
+
+	void beginFrame();
+	void beginPass(Pass pass);
+	void endFrame();
+
+	double cpuMilliseconds(Pass pass) const;
+	double gpuMilliseconds(Pass pass) const;
+
+	static const char *passName(Pass pass);
+
+}; //END class FrameProfiler.
+
+#endif
@@ -0,0 +1,92 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   frustum.cpp
+ * @author Rafael Palomar
+ * @date   Tue Jun  1 10:31:50 2010
+ *
+ * @brief  Frustum class definition.
+ *
+ * This file contains the definition of the Frustum class.
+ *
+ */
+
+#include "frustum.h"
+
+/**
+ * @brief Default constructor.
+ *
+ * The planes are set with setMatrix().
+ */
+Frustum::Frustum(){
+
+}
+
+/**
+ * @brief Set matrix.
+ *
+ * Extracts the left, right, bottom, top, near and far planes from the
+ * clip matrix, normalized so plane distances are in the units of the
+ * space the matrix maps from.
+ *
+ * @param clip the clip matrix, e.g. the projection matrix.
+ */
+void Frustum::setMatrix(const Mat4 &clip){
+
+	Vec4 x = clip.row(0);
+	Vec4 y = clip.row(1);
+	Vec4 z = clip.row(2);
+	Vec4 w = clip.row(3);
+
+	planes[0] = w + x;
+	planes[1] = w - x;
+	planes[2] = w + y;
+	planes[3] = w - y;
+	planes[4] = w + z;
+	planes[5] = w - z;
+
+	for(int i = 0; i < 6; i++)
+		planes[i] = planes[i]*(1.0f/planes[i].length3());
+}
+
+/**
+ * @brief Classify a sphere.
+ *
+ * @param center center of the sphere, in the space of the planes.
+ * @param radius radius of the sphere.
+ *
+ * @return where the sphere lies relative to the frustum.
+ */
+Frustum::Containment Frustum::classify(const Vec4 &center, float radius) const{
+
+	Containment containment = Inside;
+
+	for(int i = 0; i < 6; i++){
+
+		float distance = Vec4::dot3(planes[i], center) + planes[i].w();
+
+		if(distance < -radius)
+			return Outside;
+		if(distance < radius)
+			containment = Intersecting;
+	}
+
+	return containment;
+}
@@ -0,0 +1,62 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   frustum.h
+ * @author Rafael Palomar
+ * @date   Tue Jun  1 10:14:27 2010
+ *
+ * @brief  Frustum class header.
+ *
+ * This file contains the declaration of the class Frustum.
+ *
+ */
+
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include "simdmath.h"
+
+//!Class Frustum.
+/*!
+ * View frustum as six planes, taken from a clip matrix. The planes are in
+ * the space that matrix maps from: eye space for the projection alone.
+ */
+class Frustum{
+
+  public:
+	//!Position of a bounding sphere relative to the frustum.
+	enum Containment{
+		Outside,      //!< Completely outside, nothing to draw.
+		Intersecting, //!< Partly inside.
+		Inside        //!< Completely inside, no further tests needed.
+	};
+
+  private:
+	Vec4 planes[6];
+
+  public:
+	Frustum();
+
+	void setMatrix(const Mat4 &clip);
+	Containment classify(const Vec4 &center, float radius) const;
+
+}; //END class Frustum.
+
+#endif
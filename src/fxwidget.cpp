@@ -146,7 +146,7 @@ QSlider *FXWidget::createColorSlider(){
 void FXWidget::updateRed(int value){
 
 	fogRedValueLabel->setNum(value);
-	emit fogRedChanged(value);
+	emit fogColorChanged(value, fogGreenSlider->value(), fogBlueSlider->value());
 }
 
 /** 
@@ -159,7 +159,7 @@ void FXWidget::updateRed(int value){
 void FXWidget::updateGreen(int value){
 
 	fogGreenValueLabel->setNum(value);
-	emit fogGreenChanged(value);
+	emit fogColorChanged(fogRedSlider->value(), value, fogBlueSlider->value());
 }
 
 /** 
@@ -172,7 +172,7 @@ void FXWidget::updateGreen(int value){
 void FXWidget::updateBlue(int value){
 
 	fogBlueValueLabel->setNum(value);
-	emit fogBlueChanged(value);
+	emit fogColorChanged(fogRedSlider->value(), fogGreenSlider->value(), value);
 }
 
 /** 
@@ -75,9 +75,7 @@ class FXWidget: public QWidget{
   signals:
 	void setReflection(bool enable); //!< Emmited on reflection switching.
 	void setFog(bool enable); //!< Emmited on fog switching.
-	void fogRedChanged(int value); //!< Emmited when red has changed on fog.
-	void fogGreenChanged(int value); //!< Emmited when green has changed on fog.
-	void fogBlueChanged(int value); //!< Emmited when blue has changed on fog.
+	void fogColorChanged(int red, int green, int blue); //!< Emmited when any fog component has changed.
 	void fogStartChanged(int value); //!< Emmited when start plane has changed.
 	void fogEndChanged(int value); //!< Emmited when end plane has changed.
 
@@ -0,0 +1,123 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   glcallcounter.cpp
+ * @author Rafael Palomar
+ * @date   Mon May 17 18:20:05 2010
+ *
+ * @brief  GL call counter definition.
+ *
+ * Every entry point listed below with GL_COUNTED_CALL is wrapped at
+ * link time (-Wl,--wrap=symbol, see src/CMakeLists.txt) so calls made
+ * by the scene go through a counting function before reaching the
+ * driver. Entry points used by the scene must be added to this list
+ * to be counted.
+ *
+ */
+
+#include "glcallcounter.h"
+
+#include <GL/gl.h>
+
+static unsigned long glCallCount = 0;
+
+#ifdef BASICGL_COUNT_GL_CALLS
+
+#define GL_COUNTED_CALL(ret, name, params, args)	\
+	extern "C" ret __real_##name params;			\
+	extern "C" ret __wrap_##name params{			\
+		++glCallCount;								\
+		return __real_##name args;					\
+	}
+
+GL_COUNTED_CALL(void, glBegin, (GLenum mode), (mode))
+GL_COUNTED_CALL(void, glEnd, (), ())
+GL_COUNTED_CALL(void, glVertex3f, (GLfloat x, GLfloat y, GLfloat z), (x, y, z))
+GL_COUNTED_CALL(void, glNormal3f, (GLfloat x, GLfloat y, GLfloat z), (x, y, z))
+GL_COUNTED_CALL(void, glTexCoord2f, (GLfloat s, GLfloat t), (s, t))
+GL_COUNTED_CALL(void, glColor3ub, (GLubyte r, GLubyte g, GLubyte b), (r, g, b))
+GL_COUNTED_CALL(void, glColor4f, (GLfloat r, GLfloat g, GLfloat b, GLfloat a), (r, g, b, a))
+GL_COUNTED_CALL(void, glEnable, (GLenum cap), (cap))
+GL_COUNTED_CALL(void, glDisable, (GLenum cap), (cap))
+GL_COUNTED_CALL(void, glClear, (GLbitfield mask), (mask))
+GL_COUNTED_CALL(void, glMatrixMode, (GLenum mode), (mode))
+GL_COUNTED_CALL(void, glLoadIdentity, (), ())
+GL_COUNTED_CALL(void, glPushMatrix, (), ())
+GL_COUNTED_CALL(void, glPopMatrix, (), ())
+GL_COUNTED_CALL(void, glTranslatef, (GLfloat x, GLfloat y, GLfloat z), (x, y, z))
+GL_COUNTED_CALL(void, glRotatef, (GLfloat angle, GLfloat x, GLfloat y, GLfloat z), (angle, x, y, z))
+GL_COUNTED_CALL(void, glScalef, (GLfloat x, GLfloat y, GLfloat z), (x, y, z))
+GL_COUNTED_CALL(void, glFrontFace, (GLenum mode), (mode))
+GL_COUNTED_CALL(void, glLightfv, (GLenum light, GLenum pname, const GLfloat *params), (light, pname, params))
+GL_COUNTED_CALL(void, glBindTexture, (GLenum target, GLuint texture), (target, texture))
+GL_COUNTED_CALL(void, glBlendFunc, (GLenum sfactor, GLenum dfactor), (sfactor, dfactor))
+GL_COUNTED_CALL(void, glPolygonMode, (GLenum face, GLenum mode), (face, mode))
+GL_COUNTED_CALL(void, glPolygonOffset, (GLfloat factor, GLfloat units), (factor, units))
+GL_COUNTED_CALL(void, glFogf, (GLenum pname, GLfloat param), (pname, param))
+GL_COUNTED_CALL(void, glFogfv, (GLenum pname, const GLfloat *params), (pname, params))
+GL_COUNTED_CALL(void, glEnableClientState, (GLenum array), (array))
+GL_COUNTED_CALL(void, glDisableClientState, (GLenum array), (array))
+GL_COUNTED_CALL(void, glVertexPointer, (GLint size, GLenum type, GLsizei stride, const GLvoid *pointer), (size, type, stride, pointer))
+GL_COUNTED_CALL(void, glNormalPointer, (GLenum type, GLsizei stride, const GLvoid *pointer), (type, stride, pointer))
+GL_COUNTED_CALL(void, glTexCoordPointer, (GLint size, GLenum type, GLsizei stride, const GLvoid *pointer), (size, type, stride, pointer))
+GL_COUNTED_CALL(void, glColorPointer, (GLint size, GLenum type, GLsizei stride, const GLvoid *pointer), (size, type, stride, pointer))
+GL_COUNTED_CALL(void, glDrawArrays, (GLenum mode, GLint first, GLsizei count), (mode, first, count))
+GL_COUNTED_CALL(void, glDrawElements, (GLenum mode, GLsizei count, GLenum type, const GLvoid *indices), (mode, count, type, indices))
+GL_COUNTED_CALL(void, glMultMatrixf, (const GLfloat *m), (m))
+GL_COUNTED_CALL(void, glLoadMatrixf, (const GLfloat *m), (m))
+GL_COUNTED_CALL(void, glColor4ubv, (const GLubyte *v), (v))
+GL_COUNTED_CALL(void, glDepthFunc, (GLenum func), (func))
+GL_COUNTED_CALL(void, glDepthRange, (GLclampd zNear, GLclampd zFar), (zNear, zFar))
+GL_COUNTED_CALL(void, glGetIntegerv, (GLenum pname, GLint *params), (pname, params))
+
+#endif
+
+/**
+ * @brief GL call counter availability.
+ *
+ * @return true if the GL entry points were wrapped at link time.
+ */
+bool glCallCounterAvailable(){
+
+#ifdef BASICGL_COUNT_GL_CALLS
+	return true;
+#else
+	return false;
+#endif
+}
+
+/**
+ * @brief Reset the GL call counter.
+ *
+ */
+void glCallCounterReset(){
+
+	glCallCount = 0;
+}
+
+/**
+ * @brief GL call counter value.
+ *
+ * @return the number of GL calls counted since the last reset.
+ */
+unsigned long glCallCounterValue(){
+
+	return glCallCount;
+}
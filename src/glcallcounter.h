@@ -0,0 +1,45 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   glcallcounter.h
+ * @author Rafael Palomar
+ * @date   Mon May 17 18:12:40 2010
+ *
+ * @brief  GL call counter header.
+ *
+ * This file contains the functions to query the number of OpenGL
+ * calls issued by the scene. The counter is only available when
+ * the benchmark is linked with BASICGL_COUNT_GL_CALLS.
+ *
+ */
+
+#ifndef GLCALLCOUNTER_H
+#define GLCALLCOUNTER_H
+
+//!Returns whether GL calls are being counted in this build.
+bool glCallCounterAvailable();
+
+//!Sets the counter back to zero.
+void glCallCounterReset();
+
+//!Returns the number of GL calls since the last reset.
+unsigned long glCallCounterValue();
+
+#endif
@@ -0,0 +1,200 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   glstatecache.cpp
+ * @author Rafael Palomar
+ * @date   Thu May 27 11:43:52 2010
+ *
+ * @brief  GLStateCache class definition.
+ *
+ * This file contains the definition of the GLStateCache class.
+ *
+ */
+
+#include "glstatecache.h"
+
+#include <cstring>
+
+/**
+ * @brief Default constructor.
+ *
+ */
+GLStateCache::GLStateCache(){
+
+	filteredCount = 0;
+	invalidate();
+}
+
+/**
+ * @brief Invalidate.
+ *
+ * Forgets the whole shadow state, e.g. when the context is created.
+ *
+ */
+void GLStateCache::invalidate(){
+
+	capabilities.clear();
+	lightParameters.clear();
+	invalidateTexture();
+	polygonModeValue = 0;
+}
+
+/**
+ * @brief Invalidate texture.
+ *
+ * Forgets the texture binding, e.g. after textures are created or
+ * deleted outside the cache.
+ *
+ */
+void GLStateCache::invalidateTexture(){
+
+	boundTexture = 0;
+	textureKnown = false;
+}
+
+/**
+ * @brief Enable.
+ *
+ * @param capability the capability to enable, as for glEnable.
+ */
+void GLStateCache::enable(GLenum capability){
+
+	setEnabled(capability, true);
+}
+
+/**
+ * @brief Disable.
+ *
+ * @param capability the capability to disable, as for glDisable.
+ */
+void GLStateCache::disable(GLenum capability){
+
+	setEnabled(capability, false);
+}
+
+/**
+ * @brief Set enabled.
+ *
+ * @param capability the capability to change.
+ * @param enabled whether the capability must be enabled.
+ */
+void GLStateCache::setEnabled(GLenum capability, bool enabled){
+
+	QHash<GLenum, bool>::iterator state = capabilities.find(capability);
+
+	if(state != capabilities.end() && *state == enabled){
+		filteredCount++;
+		return;
+	}
+
+	if(enabled)
+		glEnable(capability);
+	else
+		glDisable(capability);
+
+	capabilities.insert(capability, enabled);
+}
+
+/**
+ * @brief Bind texture.
+ *
+ * @param texture the texture object to bind to GL_TEXTURE_2D.
+ */
+void GLStateCache::bindTexture(GLuint texture){
+
+	if(textureKnown && boundTexture == texture){
+		filteredCount++;
+		return;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+	boundTexture = texture;
+	textureKnown = true;
+}
+
+/**
+ * @brief Polygon mode.
+ *
+ * @param mode the rasterization mode of front and back faces.
+ */
+void GLStateCache::polygonMode(GLenum mode){
+
+	if(polygonModeValue == mode){
+		filteredCount++;
+		return;
+	}
+
+	glPolygonMode(GL_FRONT_AND_BACK, mode);
+	polygonModeValue = mode;
+}
+
+/**
+ * @brief Light parameter.
+ *
+ * Only the four component parameters (colors and position) are tracked;
+ * any other parameter is passed through. Positions are compared as given,
+ * so they must always be set under the same modelview matrix.
+ *
+ * @param light the light, as for glLightfv.
+ * @param name the parameter, as for glLightfv.
+ * @param params the values of the parameter.
+ */
+void GLStateCache::lightfv(GLenum light, GLenum name, const GLfloat *params){
+
+	if(name != GL_AMBIENT && name != GL_DIFFUSE && name != GL_SPECULAR
+	   && name != GL_POSITION){
+		glLightfv(light, name, params);
+		return;
+	}
+
+	quint64 key = ((quint64)light << 32) | name;
+	QHash<quint64, LightParameter>::iterator state = lightParameters.find(key);
+
+	if(state != lightParameters.end()
+	   && !memcmp(state->values, params, sizeof(state->values))){
+		filteredCount++;
+		return;
+	}
+
+	glLightfv(light, name, params);
+
+	LightParameter parameter;
+	memcpy(parameter.values, params, sizeof(parameter.values));
+	lightParameters.insert(key, parameter);
+}
+
+/**
+ * @brief Filtered calls.
+ *
+ * @return the number of calls dropped since resetFiltered().
+ */
+quint64 GLStateCache::filtered() const{
+
+	return filteredCount;
+}
+
+/**
+ * @brief Reset filtered calls.
+ *
+ */
+void GLStateCache::resetFiltered(){
+
+	filteredCount = 0;
+}
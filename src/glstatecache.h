@@ -0,0 +1,79 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   glstatecache.h
+ * @author Rafael Palomar
+ * @date   Thu May 27 11:20:05 2010
+ *
+ * @brief  GLStateCache class header.
+ *
+ * This file contains the declaration of the class GLStateCache.
+ *
+ */
+
+#ifndef GLSTATECACHE_H
+#define GLSTATECACHE_H
+
+#include <QHash>
+#include <QtOpenGL>
+
+//!Class GLStateCache.
+/*!
+ * Shadow copy of the GL state the scene changes every frame. Calls that
+ * would set a value the GL already has are dropped and counted.
+ *
+ * The shadow state starts unknown, so the first call of each kind always
+ * reaches the GL. Code that changes the tracked state behind its back
+ * must call invalidate().
+ */
+class GLStateCache{
+
+  private:
+	//!Four component light parameter.
+	struct LightParameter{
+		GLfloat values[4];
+	};
+
+	QHash<GLenum, bool> capabilities;
+	QHash<quint64, LightParameter> lightParameters;
+	GLuint boundTexture;
+	bool textureKnown;
+	GLenum polygonModeValue;
+	quint64 filteredCount;
+
+  public:
+	GLStateCache();
+
+	void invalidate();
+	void invalidateTexture();
+
+	void enable(GLenum capability);
+	void disable(GLenum capability);
+	void setEnabled(GLenum capability, bool enabled);
+	void bindTexture(GLuint texture);
+	void polygonMode(GLenum mode);
+	void lightfv(GLenum light, GLenum name, const GLfloat *params);
+
+	quint64 filtered() const;
+	void resetFiltered();
+
+}; //END class GLStateCache.
+
+#endif
@@ -29,11 +29,133 @@
  */
 
 #include "glwidget.h"
+#include "renderthread.h"
 
 #include <QMouseEvent>
+#include <QResizeEvent>
 #include <QMessageBox>
+#include <QTimer>
+#include <QTextStream>
+#include <QtConcurrentRun>
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+#ifndef GL_GENERATE_MIPMAP
+#define GL_GENERATE_MIPMAP 0x8191
+#endif
+
+#ifndef GL_FRAMEBUFFER
+#define GL_FRAMEBUFFER 0x8D40
+#endif
+
+#ifndef GL_FRAMEBUFFER_BINDING
+#define GL_FRAMEBUFFER_BINDING 0x8CA6
+#endif
+
+//!Vertex of the filled cube.
+struct CubeVertex{
+	GLfloat position[3];
+	GLfloat normal[3];
+	GLfloat texCoord[2];
+};
+
+//!Filled cube faces (front, back, left, right, top, bottom) as quads.
+static const CubeVertex cubeVertices[24] = {
+	{{ 1,-1, 1}, { 0, 0, 1}, {1, 0}}, {{ 1, 1, 1}, { 0, 0, 1}, {1, 1}},
+	{{-1, 1, 1}, { 0, 0, 1}, {0, 1}}, {{-1,-1, 1}, { 0, 0, 1}, {0, 0}},
+
+	{{-1,-1,-1}, { 0, 0,-1}, {1, 0}}, {{-1, 1,-1}, { 0, 0,-1}, {1, 1}},
+	{{ 1, 1,-1}, { 0, 0,-1}, {0, 1}}, {{ 1,-1,-1}, { 0, 0,-1}, {0, 0}},
+
+	{{-1,-1, 1}, {-1, 0, 0}, {1, 0}}, {{-1, 1, 1}, {-1, 0, 0}, {1, 1}},
+	{{-1, 1,-1}, {-1, 0, 0}, {0, 1}}, {{-1,-1,-1}, {-1, 0, 0}, {0, 0}},
+
+	{{ 1,-1,-1}, { 1, 0, 0}, {1, 0}}, {{ 1, 1,-1}, { 1, 0, 0}, {1, 1}},
+	{{ 1, 1, 1}, { 1, 0, 0}, {0, 1}}, {{ 1,-1, 1}, { 1, 0, 0}, {0, 0}},
+
+	{{ 1, 1, 1}, { 0, 1, 0}, {1, 0}}, {{ 1, 1,-1}, { 0, 1, 0}, {1, 1}},
+	{{-1, 1,-1}, { 0, 1, 0}, {0, 1}}, {{-1, 1, 1}, { 0, 1, 0}, {0, 0}},
+
+	{{-1,-1, 1}, { 0,-1, 0}, {1, 0}}, {{-1,-1,-1}, { 0,-1, 0}, {1, 1}},
+	{{ 1,-1,-1}, { 0,-1, 0}, {0, 1}}, {{ 1,-1, 1}, { 0,-1, 0}, {0, 0}}
+};
+
+//!Cube corners shared by the outline quads.
+static const GLfloat cubeCorners[8][3] = {
+	{-1,-1,-1}, { 1,-1,-1}, { 1, 1,-1}, {-1, 1,-1},
+	{-1,-1, 1}, { 1,-1, 1}, { 1, 1, 1}, {-1, 1, 1}
+};
+
+//!Outline quads, indexing cubeCorners.
+static const GLubyte cubeOutlineIndices[24] = {
+	5, 6, 7, 4,
+	4, 7, 3, 0,
+	0, 3, 2, 1,
+	1, 2, 6, 5,
+	6, 2, 3, 7,
+	4, 0, 1, 5
+};
+
+//!Vertex of the checkerboard floor.
+struct FloorVertex{
+	GLfloat position[2];
+	GLubyte color[4];
+};
+
+//!Vertex of the texturized floor.
+struct TexturizedFloorVertex{
+	GLfloat position[2];
+	GLfloat texCoord[2];
+};
+
+static const int framePeriod = 16; //!< Minimum time between frames, in ms (60 Hz).
+static const int floorTiles = 100;         //!< Checkerboard tiles per side.
+static const int texturizedFloorTiles = 20; //!< Texturized floor tiles per side.
 
-#include <GL/glu.h>
+/** 
+ * @brief Color component.
+ *
+ * @param value a color component, 0-255.
+ *
+ * @return the component as a light or fog color component, 0 if out of
+ * range.
+ */
+static float colorComponent(int value){
+
+	if(value<0 || value>255)
+		return 0.0f;
+
+	return value/256.0f;
+}
+
+/** 
+ * @brief Valid component.
+ *
+ * @param value a light or fog color component.
+ *
+ * @return the component, 0 if out of range.
+ */
+static float validComponent(float value){
+
+	return value >= 0.0f && value <= 1.0f ? value : 0.0f;
+}
+
+/** 
+ * @brief Cube variant.
+ *
+ * @return the program drawing the cube with the given features, so an
+ * unlit frame does not pay for the lighting.
+ */
+template<bool Lighting, bool Texturized>
+static SceneShaders::Variant cubeVariant(){
+
+	if(Lighting)
+		return Texturized ? SceneShaders::LitTextured : SceneShaders::Lit;
+
+	return Texturized ? SceneShaders::Textured : SceneShaders::Plain;
+}
 
 /** 
  * @brief Default constructor.
@@ -44,44 +166,99 @@
  * @param parent the parent widget for the GLWidget.
  */
 GLWidget::GLWidget(QWidget *parent)
-    :QGLWidget(QGLFormat(QGL::DoubleBuffer|QGL::SampleBuffers),parent){  
+    :QGLWidget(QGLFormat(QGL::DoubleBuffer|QGL::SampleBuffers),parent),
+	 cubeOutlineIndexBuffer(QGLBuffer::IndexBuffer),
+	 textureUploadBuffer(QGLBuffer::PixelUnpackBuffer){  
   
     setSizePolicy(QSizePolicy(QSizePolicy::MinimumExpanding,
 							  QSizePolicy::MinimumExpanding));
 
-    xRot = 0;
-    yRot = 0;
-    zRot = 0;
-    cubeRedComponent = 0;
-    cubeGreenComponent = 0;
-    cubeBlueComponent = 0;
+	xAngle = 0.0f;
+	yAngle = 0.0f;
+	zAngle = 0.0f;
 	cubeTexturing = false;
 	floorTexturing = false;
-	lighting = false;
-	reflection = false;
-	fog = false;
-	ambientLight[0] = 0.0f;
-	ambientLight[1] = 0.0f;
-	ambientLight[2] = 0.0f;
-	ambientLight[3] = 0.0f;
-	diffuseLight[0] = 0.0f;
-	diffuseLight[1] = 0.0f;
-	diffuseLight[2] = 0.0f;
-	diffuseLight[3] = 0.0f;
-	lightPosition[0] = 0.0f;
-	lightPosition[1] = 0.0f;
-	lightPosition[2] = 1.0f;
-	lightPosition[3] = 1.0f;	   
-	lightPositionMirror[0] = 0.0f;
-	lightPositionMirror[1] = -15.0f;
-	lightPositionMirror[2] = 1.0f;
-	lightPositionMirror[3] = 1.0f; 
-	textures[0] = 0;
-	textures[1] = 0;
-	fogColor[0] = 0;
-	fogColor[1] = 0;
-	fogColor[2] = 0;
-	fogColor[3] = 1.0f;
+	vertexBuffers = false;
+	requestedRepaints = 0;
+	renderedRepaints = 0;
+	changeDepth = 0;
+	changesPending = false;
+	pendingEvents = 0;
+	pendingInputTime = 0;
+	inputFrames = 0;
+	inputEventTotal = 0;
+	inputLatencyTotal = 0;
+	inputEventsAverage = 0.0;
+	inputLatencyAverage = 0.0;
+	inputClock.start();
+	inputReportClock.start();
+	filteredStateChanges = 0;
+	reflectionBuffers = false;
+	reflectionBuffer = 0;
+	reflectionDirty = true;
+	throughputFrames = 0;
+	cubeTextureLoading = false;
+	floorTextureLoading = false;
+	loadWarnings = true;
+	pixelBuffers = false;
+	mipmapGeneration = false;
+	capabilities.npot = false;
+	capabilities.maxSize = 1024;
+	capabilities.compressed = false;
+	capabilitiesPublished = false;
+	cubeTexture = 0;
+	floorTexture = 0;
+	shading = false;
+
+	viewMatrix = Mat4::translation(0.0f, -25.0f, 0.0f)*Mat4::rotation(25.0f, 1.0f, 0.0f, 0.0f);
+
+	//The lights stay put in the scene, so their eye coordinates are only
+	//computed once.
+	Mat4::transform(viewMatrix.data(), Vec4(0.0f, 0.0f, 1.0f).v, lightPosition);
+	Mat4::transform(viewMatrix.data(), Vec4(0.0f, -15.0f, 1.0f).v, lightPositionMirror);
+
+	repaintTimer = new QTimer(this);
+	repaintTimer->setSingleShot(true);
+	connect(repaintTimer, SIGNAL(timeout()), this, SLOT(renderScheduledFrame()));
+
+	cubeTextureWatcher = new QFutureWatcher<TextureImage>(this);
+	floorTextureWatcher = new QFutureWatcher<TextureImage>(this);
+	connect(cubeTextureWatcher, SIGNAL(finished()), this, SLOT(cubeTextureLoaded()));
+	connect(floorTextureWatcher, SIGNAL(finished()), this, SLOT(floorTextureLoaded()));
+
+	//BASICGL_PROFILE=1 prints the time of every pass to stderr.
+	state.profiling = !qgetenv("BASICGL_PROFILE").isEmpty();
+	//BASICGL_FIXED_FUNCTION=1 keeps the fixed function lighting and fog.
+	fixedFunction = !qgetenv("BASICGL_FIXED_FUNCTION").isEmpty();
+
+	//BASICGL_RENDER_THREAD=1 renders the frames in their own thread, which
+	//swaps the buffers itself once the frame is done.
+	renderThread = 0;
+	if(!qgetenv("BASICGL_RENDER_THREAD").isEmpty()){
+		renderThread = new RenderThread(this);
+		setAutoBufferSwap(false);
+	}
+
+	createScene();
+}
+
+/** 
+ * @brief Destructor.
+ *
+ * Stops the render thread, then deletes the reflection buffer while its
+ * context is still alive, and the scene graph.
+ * 
+ */
+GLWidget::~GLWidget(){
+
+	if(renderThread){
+		renderThread->stop();
+		delete renderThread;
+	}
+
+	makeCurrent();
+	delete reflectionBuffer;
+	delete sceneRoot;
 }
 
 /** 
@@ -107,6 +284,599 @@ QSize GLWidget::minimumSize() const{
 }
 
 
+/** 
+ * @brief Repaints requested.
+ * 
+ * 
+ * @return the number of repaints requested by the slots since the
+ * widget was created.
+ */
+quint64 GLWidget::repaintsRequested() const{
+
+	return requestedRepaints;
+}
+
+/** 
+ * @brief Repaints rendered.
+ * 
+ * 
+ * @return the number of frames actually rendered since the widget
+ * was created.
+ */
+quint64 GLWidget::repaintsRendered() const{
+
+	return renderedRepaints;
+}
+
+/** 
+ * @brief Textures loading.
+ * 
+ * 
+ * @return true while a texture image is being decoded.
+ */
+bool GLWidget::texturesLoading() const{
+
+	return cubeTextureLoading || floorTextureLoading;
+}
+
+/** 
+ * @brief Texture cache hits.
+ * 
+ * 
+ * @return the number of texture requests served from the texture cache.
+ */
+quint64 GLWidget::textureCacheHits() const{
+
+	return textureCache.hits();
+}
+
+/** 
+ * @brief Texture cache misses.
+ * 
+ * 
+ * @return the number of texture requests that had to load the image.
+ */
+quint64 GLWidget::textureCacheMisses() const{
+
+	return textureCache.misses();
+}
+
+/** 
+ * @brief State changes filtered.
+ * 
+ * 
+ * @return the number of redundant GL state changes dropped during the
+ * last frame.
+ */
+quint64 GLWidget::stateChangesFiltered() const{
+
+	return filteredStateChanges;
+}
+
+/** 
+ * @brief Instances.
+ * 
+ * 
+ * @return the number of cubes of the lattice, 0 if the single cube is drawn.
+ */
+int GLWidget::instances() const{
+
+	return state.instances;
+}
+
+/** 
+ * @brief Shaders enabled.
+ * 
+ * 
+ * @return true if the scene is lit and fogged by the GLSL programs, false
+ * if the fixed function pipeline is used.
+ */
+bool GLWidget::shadersEnabled() const{
+
+	return shading;
+}
+
+/** 
+ * @brief Program cache hits.
+ * 
+ * 
+ * @return the number of shader programs loaded from cached binaries.
+ */
+quint64 GLWidget::programCacheHits() const{
+
+	return programCache.hits();
+}
+
+/** 
+ * @brief Program cache misses.
+ * 
+ * 
+ * @return the number of shader programs compiled from source.
+ */
+quint64 GLWidget::programCacheMisses() const{
+
+	return programCache.misses();
+}
+
+/** 
+ * @brief Program build time.
+ * 
+ * 
+ * @return the time spent building the shader programs at startup, in
+ * nanoseconds.
+ */
+qint64 GLWidget::programBuildTime() const{
+
+	return programCache.buildTime();
+}
+
+/** 
+ * @brief Set the texture cache budget.
+ *
+ * Sets how much video memory the cached textures may use. Textures not
+ * in use are evicted, least recently used first, on the next frame.
+ * 
+ * @param bytes the budget in bytes.
+ */
+void GLWidget::setTextureCacheBudget(qint64 bytes){
+
+	textureCache.setBudget(bytes);
+	scheduleRepaint();
+}
+
+/** 
+ * @brief Scene state.
+ * 
+ * @return the scene state set so far, which the next frame renders.
+ */
+SceneState GLWidget::sceneState() const{
+
+	return state;
+}
+
+/** 
+ * @brief Apply a scene state.
+ *
+ * This function sets every parameter of the scene at once, with a single
+ * repaint. Out of range colors are set to 0 and the orientation is
+ * normalized, as the individual slots do. Textures are set with
+ * enableCubeTexture() and enableFloorTexture(), as their images have to
+ * be loaded, so the texture fields of the state are ignored.
+ *
+ * @param next the new scene state, usually sceneState() with some
+ * parameters changed.
+ */
+void GLWidget::applySceneState(const SceneState &next){
+
+	//Renormalized, so rounding does not build up as drags accumulate.
+	state.orientation = next.orientation.normalized();
+
+	for(int i = 0; i < 3; i++){
+		if(next.cubeColor[i]<0 || next.cubeColor[i]>255)
+			state.cubeColor[i] = 0;
+		else
+			state.cubeColor[i] = next.cubeColor[i];
+	}
+
+	for(int i = 0; i < 4; i++){
+		state.ambientLight[i] = validComponent(next.ambientLight[i]);
+		state.diffuseLight[i] = validComponent(next.diffuseLight[i]);
+		state.fogColor[i] = validComponent(next.fogColor[i]);
+	}
+
+	state.fogStart = next.fogStart;
+	state.fogEnd = next.fogEnd;
+	state.lighting = next.lighting;
+	state.reflection = next.reflection;
+	state.fog = next.fog;
+	state.instances = qMax(0, next.instances);
+	state.profiling = next.profiling;
+
+	scheduleRepaint();
+}
+
+/** 
+ * @brief Begin changes.
+ *
+ * Starts a transaction: the changes made through the slots until the
+ * matching commitChanges() are rendered together, with a single repaint.
+ * Transactions may be nested.
+ * 
+ */
+void GLWidget::beginChanges(){
+
+	changeDepth++;
+}
+
+/** 
+ * @brief Commit changes.
+ *
+ * Ends a transaction started with beginChanges(). The changes are
+ * repainted when the outermost transaction ends.
+ * 
+ */
+void GLWidget::commitChanges(){
+
+	if(changeDepth == 0 || --changeDepth > 0)
+		return;
+
+	if(changesPending){
+		changesPending = false;
+		scheduleRepaint();
+	}
+}
+
+/** 
+ * @brief Add a frame consumer.
+ *
+ * Every frame rendered from now on is read back asynchronously and
+ * handed to the consumer a few frames later, on the thread rendering the
+ * frames. See FrameCapture.
+ *
+ * @param consumer the consumer, which must outlive its registration.
+ */
+void GLWidget::addFrameConsumer(FrameConsumer *consumer){
+
+	capture.addConsumer(consumer);
+}
+
+/** 
+ * @brief Remove a frame consumer.
+ *
+ * Frames still in flight are not delivered to it; call flushCapture()
+ * first to get them.
+ *
+ * @param consumer a consumer added with addFrameConsumer().
+ */
+void GLWidget::removeFrameConsumer(FrameConsumer *consumer){
+
+	capture.removeConsumer(consumer);
+}
+
+/** 
+ * @brief Flush the capture.
+ *
+ * Waits for the frames being read back and delivers them. Only for
+ * widgets without a render thread, as it makes the context current.
+ * 
+ */
+void GLWidget::flushCapture(){
+
+	makeCurrent();
+	capture.flush();
+}
+
+/** 
+ * @brief Set frame dropping.
+ *
+ * Frames are dropped by default when the GPU is too far behind, so
+ * capturing never stalls rendering. Offline rendering disables it to get
+ * every frame.
+ *
+ * @param enable whether frames may be dropped.
+ */
+void GLWidget::setFrameDropping(bool enable){
+
+	capture.setFrameDropping(enable);
+}
+
+/** 
+ * @brief Set load warnings.
+ *
+ * A texture that cannot be loaded is reported with a message box by
+ * default. Without a user to dismiss it, e.g. in batch rendering, only
+ * cubeTexturingFailed() or floorTexturingFailed() is emitted.
+ *
+ * @param enable whether load errors are shown in a message box.
+ */
+void GLWidget::setLoadWarnings(bool enable){
+
+	loadWarnings = enable;
+}
+
+/** 
+ * @brief Frames captured.
+ * 
+ * @return the number of frames handed to the frame consumers.
+ */
+quint64 GLWidget::framesCaptured() const{
+
+	return capture.framesCaptured();
+}
+
+/** 
+ * @brief Frames dropped.
+ * 
+ * @return the number of frames not captured because the GPU was too far
+ * behind.
+ */
+quint64 GLWidget::framesDropped() const{
+
+	return capture.framesDropped();
+}
+
+/** 
+ * @brief Motion events per frame.
+ * 
+ * @return the average number of mouse motion events applied by each frame
+ * with motion, over the last second with motion.
+ */
+double GLWidget::motionEventsPerFrame() const{
+
+	return inputEventsAverage;
+}
+
+/** 
+ * @brief Input latency.
+ * 
+ * @return the average time from the first motion event of a frame to its
+ * buffer swap, in ms, over the last second with motion.
+ */
+double GLWidget::inputLatency() const{
+
+	return inputLatencyAverage;
+}
+
+/** 
+ * @brief Schedule a repaint.
+ *
+ * This function marks the scene as dirty. Requests made before the
+ * scheduled frame is rendered are coalesced into it, and frames are
+ * paced so at most one is rendered per display refresh.
+ * 
+ */
+void GLWidget::scheduleRepaint(){
+
+	if(changeDepth > 0){
+		changesPending = true;
+		return;
+	}
+
+	requestedRepaints++;
+
+	//The render thread paces itself on the buffer swaps.
+	if(renderThread){
+		releaseUploadedImages();
+		renderThread->post(state);
+		return;
+	}
+
+	startRepaintTimer(frameClock);
+}
+
+/** 
+ * @brief Release uploaded images.
+ *
+ * Drops the decoded images of the scene state once their textures are in
+ * the texture cache, so the states posted from then on do not keep them
+ * alive outside the cache budget. If a texture is evicted later, it is
+ * decoded again.
+ * 
+ */
+void GLWidget::releaseUploadedImages(){
+
+	if(!state.cubeTextureImage.isNull() && textureCache.contains(state.cubeTextureKey))
+		state.cubeTextureImage = TextureImage();
+
+	if(!state.floorTextureImage.isNull() && textureCache.contains(state.floorTextureKey))
+		state.floorTextureImage = TextureImage();
+}
+
+/** 
+ * @brief Start the repaint timer.
+ *
+ * Schedules renderScheduledFrame() no sooner than a frame period after
+ * the last frame, unless it is already scheduled.
+ * 
+ * @param clock started when the last frame was rendered.
+ */
+void GLWidget::startRepaintTimer(const QElapsedTimer &clock){
+
+	if(repaintTimer->isActive())
+		return;
+
+	int wait = 0;
+	if(clock.isValid())
+		wait = qMax(0, framePeriod - (int)clock.elapsed());
+
+	repaintTimer->start(wait);
+}
+
+/** 
+ * @brief Schedule mouse motion.
+ *
+ * Gets the motion accumulated by mouseMoveEvent() applied on the next
+ * frame, no sooner than a frame period after the last one.
+ * 
+ */
+void GLWidget::scheduleMotion(){
+
+	//The render thread owns frameClock; motion is paced on its own clock.
+	startRepaintTimer(renderThread ? motionClock : frameClock);
+}
+
+/** 
+ * @brief Apply mouse motion.
+ *
+ * Turns the cube by the motion accumulated since the last frame, and
+ * passes the number of events folded in and the arrival of the first one
+ * on to the frame, for framePresented() to measure.
+ * 
+ */
+void GLWidget::applyMotion(){
+
+	if(pendingEvents == 0)
+		return;
+
+	int dx = pendingTrackball.x();
+	int dy = pendingTrackball.y();
+
+	//Half a degree per pixel, applied on top of the current orientation
+	//so the cube turns the way the mouse goes whatever its orientation.
+	//Trackball: turn around the axis perpendicular to the motion.
+	Quat drag;
+	if(dx || dy)
+		drag = Quat::fromAxisAngle(0.5f*sqrtf(dx*dx + dy*dy), dy, dx, 0.0f);
+
+	if(!pendingTwist.isNull())
+		drag = Quat::fromAxisAngle(0.5f*pendingTwist.y(), 1.0f, 0.0f, 0.0f)
+			*Quat::fromAxisAngle(0.5f*pendingTwist.x(), 0.0f, 0.0f, 1.0f)*drag;
+
+	//Renormalized, so rounding does not build up as drags accumulate.
+	state.orientation = (drag*state.orientation).normalized();
+	state.inputEvents = pendingEvents;
+	state.inputTime = pendingInputTime;
+	requestedRepaints++;
+
+	pendingTrackball = QPoint();
+	pendingTwist = QPoint();
+	pendingEvents = 0;
+}
+
+/** 
+ * @brief Render the scheduled frame.
+ *
+ * Renders the frame requested through scheduleRepaint() or
+ * scheduleMotion(), with the mouse motion accumulated until now.
+ * 
+ */
+void GLWidget::renderScheduledFrame(){
+
+	applyMotion();
+
+	if(!renderThread)
+		updateGL();
+	else if(state.inputEvents > 0){
+		releaseUploadedImages();
+		renderThread->post(state);
+		motionClock.start();
+	}
+
+	//Only the frame just requested carries the input.
+	state.inputEvents = 0;
+	state.inputTime = 0;
+}
+
+/** 
+ * @brief Request a frame.
+ *
+ * Called while rendering to get one more frame rendered even if the scene
+ * state does not change, as the cube lattice needs. These frames are not
+ * counted as requested repaints, so the lattice does not skew the
+ * coalescing statistics.
+ * 
+ */
+void GLWidget::requestFrame(){
+
+	if(renderThread)
+		renderThread->requestFrame();
+	else
+		startRepaintTimer(frameClock);
+}
+
+/** 
+ * @brief Paint event.
+ *
+ * With a render thread, the first paint event hands the context over to
+ * it and the following ones ask it for a frame. Otherwise the frame is
+ * rendered here.
+ * 
+ * @param event the paint event.
+ */
+void GLWidget::paintEvent(QPaintEvent *event){
+
+	if(!renderThread){
+		QGLWidget::paintEvent(event);
+		return;
+	}
+
+	if(!renderThread->isRunning()){
+		renderThread->post(state);
+		renderThread->resize(width(), height());
+		doneCurrent();
+		renderThread->start();
+	}
+
+	renderThread->requestFrame();
+}
+
+/** 
+ * @brief Resize event.
+ *
+ * With a render thread, the new size is passed on to it, which resizes the
+ * scene before its next frame.
+ * 
+ * @param event the resize event.
+ */
+void GLWidget::resizeEvent(QResizeEvent *event){
+
+	if(!renderThread){
+		QGLWidget::resizeEvent(event);
+		return;
+	}
+
+	renderThread->resize(event->size().width(), event->size().height());
+}
+
+/** 
+ * @brief Create scene.
+ *
+ * This function builds the scene graph: the cube, its reflection and the
+ * floor, in the order they are drawn. Only one of the two floor nodes is
+ * enabled at a time. The bounds are those of the geometry the nodes draw.
+ * The root holds the view, so the world matrices of the nodes are their
+ * model view matrices.
+ * 
+ */
+void GLWidget::createScene(){
+
+	sceneRoot = new SceneNode;
+	sceneRoot->setTransform(viewMatrix);
+
+	cubeNode = new SceneCallbackNode<GLWidget>(this, &GLWidget::drawCubeNode<false, false>);
+	cubeNode->setBounds(Vec4(0.0f, 0.0f, 0.0f), sqrtf(3.0f));
+	sceneRoot->addChild(cubeNode);
+
+	reflectionNode = new SceneCallbackNode<GLWidget>(this, &GLWidget::drawReflectionNode<false, false>);
+	reflectionNode->setBounds(Vec4(0.0f, 0.0f, 0.0f), sqrtf(3.0f));
+	sceneRoot->addChild(reflectionNode);
+
+	SceneNode *floor = new SceneNode;
+	floor->setTransform(Mat4::translation(0.0f, -6.0f, -30.0f)
+						*Mat4::rotation(-90.0f, 1.0f, 0.0f, 0.0f));
+	sceneRoot->addChild(floor);
+
+	floorNode = new SceneCallbackNode<GLWidget>(this, &GLWidget::drawFloorNode);
+	floorNode->setTransform(Mat4::scaling(10.0f));
+	floorNode->setBounds(Vec4(0.0f, 0.0f, 0.0f), floorTiles/2*sqrtf(2.0f));
+	floor->addChild(floorNode);
+
+	texturizedFloorNode = new SceneCallbackNode<GLWidget>(this, &GLWidget::drawTexturizedFloorNode);
+	texturizedFloorNode->setTransform(Mat4::scaling(50.0f));
+	texturizedFloorNode->setBounds(Vec4(0.0f, 0.0f, 0.0f), texturizedFloorTiles/2*sqrtf(2.0f));
+	floor->addChild(texturizedFloorNode);
+
+	updateCubeNodes();
+	selectFramePath();
+}
+
+/** 
+ * @brief Update cube nodes.
+ *
+ * This function sets the transforms of the cube and of its reflection
+ * after the orientation of the cube. The rotation matrix is computed
+ * once for both.
+ * 
+ */
+void GLWidget::updateCubeNodes(){
+
+	Mat4 rotation = frame.orientation.toMatrix();
+
+	cubeNode->setTransform(Mat4::translation(0.0f, 4.0f, -60.0f)*rotation*Mat4::scaling(5.0f));
+	reflectionNode->setTransform(Mat4::translation(0.0f, -15.0f, -60.0f)*rotation
+								 *Mat4::scaling(5.0f, -5.0f, 5.0f));
+}
+
 /** 
  * @brief Initialize GL.
  * 
@@ -115,31 +885,175 @@ QSize GLWidget::minimumSize() const{
  */
 void GLWidget::initializeGL(){
   	
+	glState.invalidate();
+
     qglClearColor(QColor::fromRgb(0,0,0));
   
-    glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
+    glState.enable(GL_DEPTH_TEST);
+	glState.enable(GL_CULL_FACE);
     glShadeModel(GL_SMOOTH);
 
-	glLightfv(GL_LIGHT1, GL_AMBIENT, ambientLight);
-	glLightfv(GL_LIGHT1, GL_DIFFUSE, diffuseLight);
-	
-	glEnable(GL_LIGHT1);
-	glEnable(GL_COLOR_MATERIAL);
-	glColorMaterial(GL_FRONT,GL_AMBIENT_AND_DIFFUSE);  
+	glState.lightfv(GL_LIGHT1, GL_AMBIENT, frame.ambientLight);
+	glState.lightfv(GL_LIGHT1, GL_DIFFUSE, frame.diffuseLight);
+	
+	glState.enable(GL_COLOR_MATERIAL);
+	glColorMaterial(GL_FRONT,GL_AMBIENT_AND_DIFFUSE);  
+
+	glFogi(GL_FOG_MODE, GL_LINEAR);
+	glFogfv(GL_FOG_COLOR, frame.fogColor);
+	glFogf(GL_FOG_START, frame.fogStart);
+	glFogf(GL_FOG_END, frame.fogEnd);
+
+	glPolygonOffset(1.0f, 1.0f);
+
+	createCubeBuffers();
+	createFloorBuffers();
+
+	glFunctions.initializeGLFunctions(context());
+	QByteArray extensions((const char *)glGetString(GL_EXTENSIONS));
+	mipmapGeneration = glFunctions.hasOpenGLFeature(QGLFunctions::Framebuffers);
+
+	//Published once, as the textures are decoded on other threads.
+	TextureCapabilities found;
+	GLint maxTextureSize = 1024;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+	found.npot = glFunctions.hasOpenGLFeature(QGLFunctions::NPOTTextures);
+	found.maxSize = maxTextureSize;
+	found.compressed = glFunctions.hasOpenGLFeature(QGLFunctions::CompressedTextures)
+		&& extensions.contains("GL_EXT_texture_compression_s3tc");
+
+	capabilitiesMutex.lock();
+	if(!capabilitiesPublished){
+		capabilities = found;
+		capabilitiesPublished = true;
+	}
+	capabilitiesMutex.unlock();
+	QMetaObject::invokeMethod(this, "loadDeferredTextures", Qt::QueuedConnection);
+
+	//Decided once: every upload goes through the buffer or none does.
+	pixelBuffers = ((QGLFormat::openGLVersionFlags() & QGLFormat::OpenGL_Version_2_1)
+					|| extensions.contains("GL_ARB_pixel_buffer_object"))
+		&& textureUploadBuffer.create();
+	if(pixelBuffers)
+		textureUploadBuffer.setUsagePattern(QGLBuffer::StreamDraw);
+
+	profiler.initialize(context());
+	capture.initialize(context());
+	programCache.initialize(context());
+	instancedCubes.initialize(context(), programCache);
+
+	if(!fixedFunction)
+		sceneShaders.initialize(context(), programCache);
+	shading = sceneShaders.isAvailable();
+
+	reflectionBuffers = QGLFramebufferObject::hasOpenGLFramebufferObjects();
+}
+
+/** 
+ * @brief Create cube buffers.
+ *
+ * This function uploads the cube geometry (filled faces and outline)
+ * into buffer objects once, so every frame draws the cube with a couple
+ * of draw calls. If buffer objects are not supported the geometry is
+ * drawn from client memory.
+ * 
+ */
+void GLWidget::createCubeBuffers(){
+
+	vertexBuffers = cubeVertexBuffer.create()
+		&& cubeOutlineVertexBuffer.create()
+		&& cubeOutlineIndexBuffer.create();
+
+	if(!vertexBuffers)
+		return;
+
+	cubeVertexBuffer.bind();
+	cubeVertexBuffer.allocate(cubeVertices, sizeof(cubeVertices));
+	cubeVertexBuffer.release();
+
+	cubeOutlineVertexBuffer.bind();
+	cubeOutlineVertexBuffer.allocate(cubeCorners, sizeof(cubeCorners));
+	cubeOutlineVertexBuffer.release();
+
+	cubeOutlineIndexBuffer.bind();
+	cubeOutlineIndexBuffer.allocate(cubeOutlineIndices, sizeof(cubeOutlineIndices));
+	cubeOutlineIndexBuffer.release();
+}
+
+/** 
+ * @brief Create floor buffers.
+ *
+ * This function builds the whole checkerboard floor (one colored quad
+ * per tile) and the texturized floor once, so each of them is drawn with
+ * a single draw call. If buffer objects are not supported the vertices
+ * are kept in client memory.
+ * 
+ */
+void GLWidget::createFloorBuffers(){
+
+	floorVertexData.resize(floorTiles*floorTiles*4*sizeof(FloorVertex));
+	FloorVertex *vertex = (FloorVertex *)floorVertexData.data();
+
+	for(int i=-floorTiles/2; i<floorTiles/2; i++){
+ 		for(int j=-floorTiles/2; j<floorTiles/2; j++){
+
+			GLubyte shade = ((i+j)%2) ? 255 : 0;
+			const GLfloat corners[4][2] = {{i+1.0f, (GLfloat)j},
+										   {i+1.0f, j+1.0f},
+										   {(GLfloat)i, j+1.0f},
+										   {(GLfloat)i, (GLfloat)j}};
+
+			for(int k=0; k<4; k++, vertex++){
+				vertex->position[0] = corners[k][0];
+				vertex->position[1] = corners[k][1];
+				vertex->color[0] = shade;
+				vertex->color[1] = shade;
+				vertex->color[2] = shade;
+				vertex->color[3] = 204; //0.8 alpha
+			}
+		}
+	}
+
+	texturizedFloorVertexData.resize(texturizedFloorTiles*texturizedFloorTiles*4
+									 *sizeof(TexturizedFloorVertex));
+	TexturizedFloorVertex *texVertex =
+		(TexturizedFloorVertex *)texturizedFloorVertexData.data();
+
+	for(int i=-texturizedFloorTiles/2; i<texturizedFloorTiles/2; i++){
+ 		for(int j=-texturizedFloorTiles/2; j<texturizedFloorTiles/2; j++){
+
+			const GLfloat corners[4][4] = {{i+1.0f, (GLfloat)j, 1.0f, 0.0f},
+										   {i+1.0f, j+1.0f, 1.0f, 1.0f},
+										   {(GLfloat)i, j+1.0f, 0.0f, 1.0f},
+										   {(GLfloat)i, (GLfloat)j, 0.0f, 0.0f}};
+
+			for(int k=0; k<4; k++, texVertex++){
+				texVertex->position[0] = corners[k][0];
+				texVertex->position[1] = corners[k][1];
+				texVertex->texCoord[0] = corners[k][2];
+				texVertex->texCoord[1] = corners[k][3];
+			}
+		}
+	}
+
+	vertexBuffers = vertexBuffers
+		&& floorVertexBuffer.create()
+		&& texturizedFloorVertexBuffer.create();
 
-	glGenTextures(2,textures);
-	
-	glBindTexture(GL_TEXTURE_2D,textures[0]);  		
-	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);	// Linear Filtering
-	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);	// Linear Filtering  
-	glBindTexture(GL_TEXTURE_2D,textures[1]);  		
-	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);	// Linear Filtering
-	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);	// Linear Filtering  
-	
-	glFogi(GL_FOG_MODE, GL_LINEAR);
-	glFogf(GL_FOG_START, 0.0f);
-	glFogf(GL_FOG_END, 0.0f);
+	if(!vertexBuffers)
+		return;
+
+	floorVertexBuffer.bind();
+	floorVertexBuffer.allocate(floorVertexData.constData(), floorVertexData.size());
+	floorVertexBuffer.release();
+
+	texturizedFloorVertexBuffer.bind();
+	texturizedFloorVertexBuffer.allocate(texturizedFloorVertexData.constData(),
+										 texturizedFloorVertexData.size());
+	texturizedFloorVertexBuffer.release();
+
+	floorVertexData.clear();
+	texturizedFloorVertexData.clear();
 }
 
 /** 
@@ -154,11 +1068,35 @@ void GLWidget::resizeGL(int width, int height){
 	//    glViewport((width-side)/2,(height-side)/2,side,side);
 	glViewport(0,0,width,height);
 
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
+	//The projection only changes here. The programs take it from their
+	//parameters; the fixed function and the lattice from the GL matrix.
+	if(height > 0)
+		projectionMatrix = Mat4::perspective(45.0f, (GLfloat)width/(GLfloat)height, 1.0f, 200.0f);
 
-    gluPerspective(45.0f,(GLfloat)width/(GLfloat)height,1.0f,200.0f);
+    glMatrixMode(GL_PROJECTION);
+	glLoadMatrixf(projectionMatrix.data());
     glMatrixMode(GL_MODELVIEW);
+
+	//The scene nodes are culled in eye space.
+	frustum.setMatrix(projectionMatrix);
+
+	capture.resize(width, height);
+
+	delete reflectionBuffer;
+	reflectionBuffer = 0;
+
+	if(reflectionBuffers && width > 0 && height > 0){
+		reflectionBuffer = new QGLFramebufferObject(width, height,
+													QGLFramebufferObject::Depth);
+		if(!reflectionBuffer->isValid()){
+			delete reflectionBuffer;
+			reflectionBuffer = 0;
+		}
+	}
+
+	//Creating the buffer binds its texture behind the state cache.
+	glState.invalidateTexture();
+	reflectionDirty = true;
 }
 
 /** 
@@ -170,100 +1108,367 @@ void GLWidget::resizeGL(int width, int height){
  */
 void GLWidget::paintGL(){
 
+	const SceneState *next = takeState();
+	if(next)
+		applyFrameState(*next);
+
+	//Rendering straight from the scene state, which is ours to change.
+	if(next == &state)
+		releaseUploadedImages();
+
+	renderedRepaints++;
+	frameClock.start();
+	glState.resetFiltered();
+	profiler.beginFrame();
+	profiler.beginPass(FrameProfiler::Clear);
 	
     glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
   
+	//The nodes carry their own model view matrices, view included.
 	glMatrixMode(GL_MODELVIEW);
     glLoadIdentity();
-	glTranslatef(0.0f, -25.0f, 0.0f);
-	glRotatef(25, 1.0f, 0.0f, 0.0f);
 
-	glColor3ub(1,1,1);
+	(this->*renderFrame)();
+
+	profiler.endFrame();
+	filteredStateChanges = glState.filtered();
+
+	//Before the swap, while the frame is still in the back buffer.
+	capture.captureFrame();
 
- 	if(lighting){
-		
-		glEnable(GL_LIGHT1);
-		glEnable(GL_LIGHTING);
-		glEnable(GL_NORMALIZE);
+	//The lattice is a stress test: keep rendering and report throughput.
+	if(instancedCubes.count() > 0){
+		throughputFrames++;
+		qint64 elapsed = throughputClock.elapsed();
+		if(elapsed >= 1000){
+			emit(instanceThroughputChanged(instancedCubes.count()*throughputFrames*1000.0/elapsed));
+			throughputFrames = 0;
+			throughputClock.start();
+		}
+		requestFrame();
 	}
-	
-	if(reflection){
+}
+
+/** 
+ * @brief Draw.
+ *
+ * Renders and swaps a frame when there is no render thread.
+ * 
+ */
+void GLWidget::glDraw(){
 
-		glFrontFace(GL_CW);
-		glLightfv(GL_LIGHT1, GL_POSITION, lightPositionMirror);
+	QGLWidget::glDraw();
 
-		glPushMatrix(); //PUSH
+	if(!renderThread)
+		framePresented();
+}
+
+/** 
+ * @brief Frame presented.
+ *
+ * Called once the buffers of a frame have been swapped. For frames with
+ * mouse motion, it measures the motion events folded into the frame and
+ * the time from the first of them to the swap. The averages are printed
+ * to stderr once per second while profiling.
+ * 
+ */
+void GLWidget::framePresented(){
+
+	if(frame.inputEvents > 0){
+		inputFrames++;
+		inputEventTotal += frame.inputEvents;
+		inputLatencyTotal += inputClock.nsecsElapsed() - frame.inputTime;
+		frame.inputEvents = 0;
+	}
 
-		glTranslatef(0.0f, -15.0f, -60.0f);	
-		glRotatef(xRot/16,1.0f, 0.0f, 0.0f);
-		glRotatef(yRot/16,0.0f, 1.0f, 0.0f);
-		glRotatef(zRot/16,0.0f, 0.0f, 1.0f);
-		glScalef(5.0f, -5.0f, 5.0f);
-		if(cubeTexturing){
+	if(inputReportClock.elapsed() < 1000)
+		return;
 
-			glEnable(GL_TEXTURE_2D);
-			glBindTexture(GL_TEXTURE_2D,textures[0]);  	
-			drawTexturizedCube();
-			glDisable(GL_TEXTURE_2D);
+	if(inputFrames > 0){
+		inputEventsAverage = (double)inputEventTotal/inputFrames;
+		inputLatencyAverage = inputLatencyTotal/1.0e6/inputFrames;
+
+		if(frame.profiling){
+			QTextStream err(stderr);
+			err.setRealNumberPrecision(3);
+			err.setRealNumberNotation(QTextStream::FixedNotation);
+			err << "input, " << inputFrames << " frames: " << inputEventsAverage
+				<< " motion events/frame, " << inputLatencyAverage
+				<< " ms input to present\n";
 		}
-		else
-			drawCube();			
+	}
+
+	inputFrames = 0;
+	inputEventTotal = 0;
+	inputLatencyTotal = 0;
+	inputReportClock.start();
+}
+
+/** 
+ * @brief Take the scene state.
+ *
+ * @return the scene state to render, or 0 if the render thread has no new
+ * one, so the last one is rendered again.
+ */
+const SceneState *GLWidget::takeState(){
+
+	if(!renderThread || !renderThread->isRunning())
+		return &state;
+
+	return renderThread->take() ? &renderThread->state() : 0;
+}
+
+/** 
+ * @brief Apply frame state.
+ *
+ * This function brings the GL state, the scene graph and the textures in
+ * line with a new scene state. Only what changed since the last frame is
+ * applied, and the cached reflection is only marked dirty if the cube may
+ * look different.
+ *
+ * @param next the scene state to render.
+ */
+void GLWidget::applyFrameState(const SceneState &next){
+
+	bool changed = false;
+	bool switches = false;
 
-		glPopMatrix(); //POP
-		glFrontFace(GL_CCW);
+	if(memcmp(next.orientation.q, frame.orientation.q, sizeof(frame.orientation.q))){
+		frame.orientation = next.orientation;
+		updateCubeNodes();
+		changed = true;
 	}
 
-	glLightfv(GL_LIGHT1, GL_POSITION, lightPosition);
+	if(memcmp(next.cubeColor, frame.cubeColor, sizeof(frame.cubeColor))){
+		memcpy(frame.cubeColor, next.cubeColor, sizeof(frame.cubeColor));
+		changed = true;
+	}
 
-	glPushMatrix();
+	if(memcmp(next.ambientLight, frame.ambientLight, sizeof(frame.ambientLight))){
+		memcpy(frame.ambientLight, next.ambientLight, sizeof(frame.ambientLight));
+		glState.lightfv(GL_LIGHT1, GL_AMBIENT, frame.ambientLight);
+		changed = true;
+	}
 
-	glTranslatef(0.0f, 4.0f, -60.0f);	
-	glRotatef(xRot/16,1.0f, 0.0f, 0.0f);
-    glRotatef(yRot/16,0.0f, 1.0f, 0.0f);
-    glRotatef(zRot/16,0.0f, 0.0f, 1.0f);
-	glScalef(5.0f, 5.0f, 5.0f);
-
-	if(cubeTexturing){
-		glEnable(GL_TEXTURE_2D);
-		glBindTexture(GL_TEXTURE_2D,textures[0]);
-		drawTexturizedCube();
-		glDisable(GL_TEXTURE_2D);
+	if(memcmp(next.diffuseLight, frame.diffuseLight, sizeof(frame.diffuseLight))){
+		memcpy(frame.diffuseLight, next.diffuseLight, sizeof(frame.diffuseLight));
+		glState.lightfv(GL_LIGHT1, GL_DIFFUSE, frame.diffuseLight);
+		changed = true;
 	}
-	else
-		drawCube();			
 
+	if(next.fog != frame.fog || next.fogStart != frame.fogStart || next.fogEnd != frame.fogEnd
+	   || memcmp(next.fogColor, frame.fogColor, sizeof(frame.fogColor))){
 
-	glPopMatrix();
+		frame.fog = next.fog;
+		frame.fogStart = next.fogStart;
+		frame.fogEnd = next.fogEnd;
+		memcpy(frame.fogColor, next.fogColor, sizeof(frame.fogColor));
+
+		glFogfv(GL_FOG_COLOR, frame.fogColor);
+		glFogf(GL_FOG_START, frame.fogStart);
+		glFogf(GL_FOG_END, frame.fogEnd);
 
-	if(lighting){
-		glDisable(GL_LIGHTING);
-		glDisable(GL_LIGHT1);
-		glDisable(GL_NORMALIZE);
+		//The background takes the fog color, so distant geometry fades into it.
+		if(frame.fog)
+			glClearColor(frame.fogColor[0], frame.fogColor[1], frame.fogColor[2], 1.0f);
+		else
+			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+		changed = true;
 	}
 
+	if(next.lighting != frame.lighting || next.reflection != frame.reflection){
+		frame.lighting = next.lighting;
+		frame.reflection = next.reflection;
+		switches = true;
+		changed = true;
+	}
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glPushMatrix();
-	glTranslatef(0.0f, -6.0f, -30.0f);
-	glRotatef(-90.0f, 1.0f, 0.0f, 0.0f);
+	if(next.instances != frame.instances){
+		frame.instances = next.instances;
+		instancedCubes.setCount(frame.instances);
+		throughputFrames = 0;
+		throughputClock.start();
+		switches = true;
+		changed = true;
+	}
+
+	if(next.profiling != frame.profiling){
+		frame.profiling = next.profiling;
+		profiler.setEnabled(frame.profiling);
+	}
 
+	frame.inputEvents = next.inputEvents;
+	frame.inputTime = next.inputTime;
 
-	if(floorTexturing){
-		glScalef(50.0f, 50.0f, 50.0f);
-		glBindTexture(GL_TEXTURE_2D,textures[1]);  	
-		glEnable(GL_TEXTURE_2D);
-		drawTexturizedFloor();
-		glDisable(GL_TEXTURE_2D);
+	if(updateTexture(next.cubeTextureKey, next.cubeTextureImage,
+					 frame.cubeTextureKey, cubeTexture)){
+		cubeTexturing = cubeTexture != 0;
+		switches = true;
+		changed = true;
 	}
-	else{
-		glScalef(10.0f, 10.0f, 10.0f);
-		drawFloor();
+
+	if(updateTexture(next.floorTextureKey, next.floorTextureImage,
+					 frame.floorTextureKey, floorTexture)){
+		floorTexturing = floorTexture != 0;
+		switches = true;
 	}
 
-	glPopMatrix();
+	if(textureCache.trim())
+		glState.invalidateTexture();
+
+	if(switches)
+		selectFramePath();
+	if(changed)
+		reflectionDirty = true;
+}
+
+/** 
+ * @brief Update texture.
+ *
+ * This function binds the texture named by a scene state. It is taken
+ * from the texture cache, or uploaded from the decoded image into a new
+ * cache entry. If it was evicted before the image came along, the image
+ * is decoded again and the current texture is kept meanwhile.
+ *
+ * @param key the texture cache key, empty for no texture.
+ * @param image the decoded image, if any.
+ * @param boundKey the key of the texture currently bound.
+ * @param texture the texture currently bound.
+ *
+ * @return true if the texture changed.
+ */
+bool GLWidget::updateTexture(const QString &key, const TextureImage &image,
+							 QString &boundKey, GLuint &texture){
+
+	if(key == boundKey)
+		return false;
+
+	GLuint next = 0;
+
+	if(!key.isEmpty()){
+
+		next = textureCache.acquire(key);
+
+		if(!next && image.isNull()){
+			QMetaObject::invokeMethod(this, "loadMissingTextures", Qt::QueuedConnection);
+			return false;
+		}
+
+		if(!next){
+			next = textureCache.insert(key, image.byteCount());
+			glState.invalidateTexture();	//insert() binds the textures it creates.
+			if(image.ktx.isNull())
+				uploadTexture(next, image.image);
+			else
+				uploadCompiledTexture(next, *image.ktx);
+		}
+	}
+
+	textureCache.release(texture);
+	texture = next;
+	boundKey = key;
+	return true;
+}
+
+/** 
+ * @brief Render frame path.
+ *
+ * This function draws the scene for one combination of the feature
+ * switches, so each combination gets its own straight frame function
+ * with the switches folded away.
+ * 
+ */
+template<bool Lighting, bool Reflection, bool CubeTexturing, bool FloorTexturing>
+void GLWidget::renderFramePath(){
+
+	glColor3ub(1,1,1);
+
+	//Light 1 and normalization only matter while lighting is enabled, so
+	//they follow the lighting switch instead of every frame. The programs
+	//do their own lighting and fog.
+	glState.setEnabled(GL_LIGHT1, Lighting && !shading);
+	glState.setEnabled(GL_NORMALIZE, Lighting && !shading);
+	glState.setEnabled(GL_LIGHTING, Lighting && !shading);
+	glState.setEnabled(GL_FOG, frame.fog && !shading);
+	glState.disable(GL_BLEND);
+	glState.setEnabled(GL_TEXTURE_2D, CubeTexturing);
+	if(CubeTexturing)
+		glState.bindTexture(cubeTexture);
+
+	reflectionNode->setEnabled(Reflection);
+	floorNode->setEnabled(!FloorTexturing);
+	texturizedFloorNode->setEnabled(FloorTexturing);
+
+	if(shading)
+		updateSceneParameters();
+
+	sceneRoot->render(frustum);
+
+	if(shading)
+		sceneShaders.release();
+}
 
-	glDisable(GL_BLEND);
+/** 
+ * @brief Select frame path.
+ *
+ * This function picks the frame function and the node functions for the
+ * current feature switches. It is called whenever one of them changes.
+ * 
+ */
+void GLWidget::selectFramePath(){
+
+	//Indexed by lighting, reflection, cube texturing and floor texturing.
+	static const FrameFunction paths[16] = {
+		&GLWidget::renderFramePath<false, false, false, false>,
+		&GLWidget::renderFramePath<false, false, false, true>,
+		&GLWidget::renderFramePath<false, false, true, false>,
+		&GLWidget::renderFramePath<false, false, true, true>,
+		&GLWidget::renderFramePath<false, true, false, false>,
+		&GLWidget::renderFramePath<false, true, false, true>,
+		&GLWidget::renderFramePath<false, true, true, false>,
+		&GLWidget::renderFramePath<false, true, true, true>,
+		&GLWidget::renderFramePath<true, false, false, false>,
+		&GLWidget::renderFramePath<true, false, false, true>,
+		&GLWidget::renderFramePath<true, false, true, false>,
+		&GLWidget::renderFramePath<true, false, true, true>,
+		&GLWidget::renderFramePath<true, true, false, false>,
+		&GLWidget::renderFramePath<true, true, false, true>,
+		&GLWidget::renderFramePath<true, true, true, false>,
+		&GLWidget::renderFramePath<true, true, true, true>
+	};
+
+	//The cube lattice replaces the cube and its reflection.
+	bool lattice = instancedCubes.count() > 0;
+
+	renderFrame = paths[(frame.lighting ? 8 : 0)
+						| (frame.reflection && !lattice ? 4 : 0)
+						| (cubeTexturing ? 2 : 0)
+						| (floorTexturing ? 1 : 0)];
+
+	//Indexed by lighting and cube texturing.
+	static const SceneCallbackNode<GLWidget>::DrawFunction cubeNodes[4] = {
+		&GLWidget::drawCubeNode<false, false>,
+		&GLWidget::drawCubeNode<false, true>,
+		&GLWidget::drawCubeNode<true, false>,
+		&GLWidget::drawCubeNode<true, true>
+	};
+
+	static const SceneCallbackNode<GLWidget>::DrawFunction reflectionNodes[4] = {
+		&GLWidget::drawReflectionNode<false, false>,
+		&GLWidget::drawReflectionNode<false, true>,
+		&GLWidget::drawReflectionNode<true, false>,
+		&GLWidget::drawReflectionNode<true, true>
+	};
+
+	int node = (frame.lighting ? 2 : 0) | (cubeTexturing ? 1 : 0);
+
+	if(lattice)
+		cubeNode->setFunction(&GLWidget::drawLatticeNode);
+	else
+		cubeNode->setFunction(cubeNodes[node]);
+
+	reflectionNode->setFunction(reflectionNodes[node]);
 }
 
 /** 
@@ -285,94 +1490,122 @@ void GLWidget::mousePressEvent(QMouseEvent *event){
  * This function defines what to do when the mouse
  * is pressed and moved around the scene, that is,
  * makes rotations for the cube regarding the mouse movement and status.
+ * The motion is accumulated until the next frame, so a fast mouse costs
+ * one frame per frame period rather than one per event.
  * 
  * @param event the mouse event recorded.
  */
 void GLWidget::mouseMoveEvent(QMouseEvent *event){
 
-    int dx = event->x() - lastPos.x();
-    int dy = event->y() - lastPos.y();
+    QPoint delta = event->pos() - lastPos;
+    lastPos = event->pos();
 
-    if(event->buttons() & Qt::LeftButton){
-    
-		setXRotation(xRot + dy*8);
-		setYRotation(yRot + dx*8);  
+	//Only accumulated here; applyMotion() turns the cube once per frame.
+    if(event->buttons() & Qt::LeftButton)
+		pendingTrackball += delta;
+    else if(event->buttons() & Qt::RightButton)
+		pendingTwist += delta;
+	else
+		return;
 
-    } else if(event->buttons() & Qt::RightButton){
-    
-		setXRotation(xRot + dy*8);
-		setZRotation(zRot + dx*8);  
-    }
+	if(pendingEvents++ == 0)
+		pendingInputTime = inputClock.nsecsElapsed();
 
-    lastPos = event->pos();
+	scheduleMotion();
 }
 
 /** 
  * @brief Set x angle rotation.
  * 
- * This function updates the x rotation angle by modifying
- * the inner variable that keeps this value.
+ * This function sets the rotation around the x axis. The orientation of
+ * the cube becomes the rotations around x, y and z by the last angles
+ * set, replacing any rotation made with the mouse.
  * 
- * @param angle new x angle
+ * @param angle new x angle, in 1/16 degrees.
  */
 void GLWidget::setXRotation(int angle){
   
-    //Normalize Angle
-    while(angle < 0)
-		angle += 360*16;
-    while(angle > 360*16)
-		angle -= 360*16;
-
-    if(angle != xRot){
-		xRot = angle;
-		updateGL();
-    }
+	setAngles(angle/16.0f, yAngle, zAngle);
 }
 
 
 /** 
  * @brief Set y angle rotation.
  * 
- * This function updates the y rotation angle by modifying
- * the inner variable that keeps this value.
+ * This function sets the rotation around the y axis, as
+ * setXRotation() does.
  * 
- * @param angle new y angle
+ * @param angle new y angle, in 1/16 degrees.
  */
 void GLWidget::setYRotation(int angle){
   
-    //Normalize Angle
-    while(angle < 0)
-		angle += 360*16;
-    while(angle > 360*16)
-		angle -= 360*16;
-  
-    if(angle != yRot){
-		yRot = angle;
-		updateGL();
-    }
+	setAngles(xAngle, angle/16.0f, zAngle);
 }
 
 
 /** 
  * @brief Set z angle rotation.
  * 
- * This function updates the z rotation angle by modifying
- * the inner variable that keeps this value.
+ * This function sets the rotation around the z axis, as
+ * setXRotation() does.
  * 
- * @param angle new z angle
+ * @param angle new z angle, in 1/16 degrees.
  */
 void GLWidget::setZRotation(int angle){
   
-    //Normalize Angle
-    while(angle < 0)
-		angle += 360*16;
-    while(angle > 360*16)
-		angle -= 360*16;
-
-    if(angle != zRot){
-		zRot = angle;
-		updateGL();
-    }
+	setAngles(xAngle, yAngle, angle/16.0f);
+}
+
+/** 
+ * @brief Set angles.
+ * 
+ * This function sets the orientation of the cube to the rotations
+ * around x, y and z by the given angles.
+ * 
+ * @param x angle around the x axis, in degrees.
+ * @param y angle around the y axis, in degrees.
+ * @param z angle around the z axis, in degrees.
+ */
+void GLWidget::setAngles(float x, float y, float z){
+
+	x = fmodf(x, 360.0f);
+	y = fmodf(y, 360.0f);
+	z = fmodf(z, 360.0f);
+
+	if(x == xAngle && y == yAngle && z == zAngle)
+		return;
+
+	xAngle = x;
+	yAngle = y;
+	zAngle = z;
+
+	setCubeOrientation(Quat::fromAxisAngle(x, 1.0f, 0.0f, 0.0f)
+					   *Quat::fromAxisAngle(y, 0.0f, 1.0f, 0.0f)
+					   *Quat::fromAxisAngle(z, 0.0f, 0.0f, 1.0f));
+}
+
+/** 
+ * @brief Cube orientation.
+ * 
+ * @return the rotation of the cube.
+ */
+Quat GLWidget::cubeOrientation() const{
+
+	return state.orientation;
+}
+
+/** 
+ * @brief Set cube orientation.
+ * 
+ * This function sets the rotation of the cube and of its reflection.
+ * 
+ * @param rotation the new rotation.
+ */
+void GLWidget::setCubeOrientation(const Quat &rotation){
+
+	SceneState next = state;
+	next.orientation = rotation;
+	applySceneState(next);
 }
 
 /** 
@@ -384,13 +1617,10 @@ void GLWidget::setZRotation(int angle){
  * @param value new value for the red component of the cube.
  */
 void GLWidget::setCubeRedComponent(int value){
-  
-    if(value<0 || value>255)
-		cubeRedComponent = 0;
-    else
-		cubeRedComponent = value;
-  
-    updateGL();  
+
+	SceneState next = state;
+	next.cubeColor[0] = value;
+	applySceneState(next);
 }
 
 /** 
@@ -402,13 +1632,10 @@ void GLWidget::setCubeRedComponent(int value){
  * @param value new value for the green component of the cube.
  */
 void GLWidget::setCubeGreenComponent(int value){
-  
-    if(value<0 || value>255)
-		cubeGreenComponent = 0;
-    else
-		cubeGreenComponent = value;
-  
-    updateGL();  
+
+	SceneState next = state;
+	next.cubeColor[1] = value;
+	applySceneState(next);
 }
 
 /** 
@@ -420,13 +1647,28 @@ void GLWidget::setCubeGreenComponent(int value){
  * @param value new value for the blue component of the cube.
  */
 void GLWidget::setCubeBlueComponent(int value){
-  
-    if(value<0 || value>255)
-		cubeBlueComponent = 0;
-    else
-		cubeBlueComponent = value;
-  
-    updateGL();  
+
+	SceneState next = state;
+	next.cubeColor[2] = value;
+	applySceneState(next);
+}
+
+/** 
+ * @brief Set the cube color.
+ *
+ * This function sets the three components of the cube color at once.
+ *
+ * @param red new value for the red component of the cube.
+ * @param green new value for the green component of the cube.
+ * @param blue new value for the blue component of the cube.
+ */
+void GLWidget::setCubeColor(int red, int green, int blue){
+
+	SceneState next = state;
+	next.cubeColor[0] = red;
+	next.cubeColor[1] = green;
+	next.cubeColor[2] = blue;
+	applySceneState(next);
 }
 
 /** 
@@ -438,15 +1680,10 @@ void GLWidget::setCubeBlueComponent(int value){
  * @param value new value for the blue component of the cube.
  */
 void GLWidget::setAmbientLightRedComponent(int value){
-  
-    if(value<0 || value>255)
-		ambientLight[0] = 0;
-    else
-		ambientLight[0] = value/256.0f;
 
-	glLightfv(GL_LIGHT1, GL_AMBIENT, ambientLight);
-  
-    updateGL();  
+	SceneState next = state;
+	next.ambientLight[0] = colorComponent(value);
+	applySceneState(next);
 }
 
 /** 
@@ -458,15 +1695,10 @@ void GLWidget::setAmbientLightRedComponent(int value){
  * @param value new value for the blue component of the cube.
  */
 void GLWidget::setAmbientLightGreenComponent(int value){
-  
-    if(value<0 || value>255)
-		ambientLight[1] = 0;
-    else
-		ambientLight[1] = value/256.0f;
 
-	glLightfv(GL_LIGHT1, GL_AMBIENT, ambientLight);
-  
-    updateGL();  
+	SceneState next = state;
+	next.ambientLight[1] = colorComponent(value);
+	applySceneState(next);
 }
 
 /** 
@@ -478,16 +1710,30 @@ void GLWidget::setAmbientLightGreenComponent(int value){
  * @param value new value for the blue component of the cube.
  */
 void GLWidget::setAmbientLightBlueComponent(int value){
-  
-    if(value<0 || value>255)
-		ambientLight[2] = 0;
-    else
-		ambientLight[2] = value/256.0f;
 
-	glLightfv(GL_LIGHT1, GL_AMBIENT, ambientLight);
-  
-    updateGL();  
+	SceneState next = state;
+	next.ambientLight[2] = colorComponent(value);
+	applySceneState(next);
+}
+
+/** 
+ * @brief Set the ambient light.
+ *
+ * This function sets the three components of the ambient light at once.
+ *
+ * @param red new value for the red component, 0-255.
+ * @param green new value for the green component, 0-255.
+ * @param blue new value for the blue component, 0-255.
+ */
+void GLWidget::setAmbientLight(int red, int green, int blue){
+
+	SceneState next = state;
+	next.ambientLight[0] = colorComponent(red);
+	next.ambientLight[1] = colorComponent(green);
+	next.ambientLight[2] = colorComponent(blue);
+	applySceneState(next);
 }
+
 /** 
  * @brief Set the red component of the diffuse light.
  *
@@ -497,15 +1743,10 @@ void GLWidget::setAmbientLightBlueComponent(int value){
  * @param value new value for the blue component of the cube.
  */
 void GLWidget::setDiffuseLightRedComponent(int value){
-  
-    if(value<0 || value>255)
-		diffuseLight[0] = 0;
-    else
-		diffuseLight[0] = value/256.0f;
-
-	glLightfv(GL_LIGHT1, GL_DIFFUSE, diffuseLight);
 
-    updateGL();  
+	SceneState next = state;
+	next.diffuseLight[0] = colorComponent(value);
+	applySceneState(next);
 }
 
 /** 
@@ -517,15 +1758,10 @@ void GLWidget::setDiffuseLightRedComponent(int value){
  * @param value new value for the blue component of the cube.
  */
 void GLWidget::setDiffuseLightGreenComponent(int value){
-  
-    if(value<0 || value>255)
-		diffuseLight[1] = 0;
-    else
-		diffuseLight[1] = value/256.0f;
 
-	glLightfv(GL_LIGHT1, GL_DIFFUSE, diffuseLight);
-  
-    updateGL();  
+	SceneState next = state;
+	next.diffuseLight[1] = colorComponent(value);
+	applySceneState(next);
 }
 
 /** 
@@ -537,123 +1773,322 @@ void GLWidget::setDiffuseLightGreenComponent(int value){
  * @param value new value for the blue component of the cube.
  */
 void GLWidget::setDiffuseLightBlueComponent(int value){
-  
-    if(value<0 || value>255)
-		diffuseLight[2] = 0;
-    else
-		diffuseLight[2] = value/256.0f;
 
-	glLightfv(GL_LIGHT1, GL_DIFFUSE, diffuseLight);
-  
-    updateGL();  
+	SceneState next = state;
+	next.diffuseLight[2] = colorComponent(value);
+	applySceneState(next);
+}
+
+/** 
+ * @brief Set the diffuse light.
+ *
+ * This function sets the three components of the diffuse light at once.
+ *
+ * @param red new value for the red component, 0-255.
+ * @param green new value for the green component, 0-255.
+ * @param blue new value for the blue component, 0-255.
+ */
+void GLWidget::setDiffuseLight(int red, int green, int blue){
+
+	SceneState next = state;
+	next.diffuseLight[0] = colorComponent(red);
+	next.diffuseLight[1] = colorComponent(green);
+	next.diffuseLight[2] = colorComponent(blue);
+	applySceneState(next);
 }
 
 /** 
  * @brief Enable the cube texture
  *
- * This function activates the texturing for the cube by loading the image texture
- * and setting the appropiates variables to enable the texturing mode on the cube. 
+ * This function textures the cube on the next frame if the image is in
+ * the texture cache. Otherwise it starts loading the image on a worker
+ * thread. The cube keeps its current texture until the new one has been
+ * uploaded, which happens on the first frame after decoding finishes.
  *
  * @param imageFileName the name of the image file that contains the texture data.
  */
 void GLWidget::enableCubeTexture(const QString &imageFileName){
 
-	QImage image;
+	cubeTextureFile = imageFileName;
+	state.cubeTextureKey = TextureCache::key(imageFileName);
+	state.cubeTextureImage = TextureImage();
 
-	if(!image.load(imageFileName)){
-		QMessageBox::warning(this,
-							 "Load Image Error", 
-							 "Loading image for cube texturing was impossible");
-		emit(cubeTexturingFailed());
+	if(textureCache.contains(state.cubeTextureKey)){
+		cubeTextureLoading = false;
+		scheduleRepaint();
 		return;
 	}
 
-	if( (image.width()!= 256 && image.height() != 512)
-		|| image.width() != image.height()){
-		
-		QMessageBox::warning(this,
-							 "Image Size Error", 
-							 "The image must be 256x256 or 512x512");
-		emit(cubeTexturingFailed());
+	cubeTextureLoading = true;
+	loadTexture(cubeTextureWatcher, imageFileName);
+}
+
+/** 
+ * @brief Enable the floor texture
+ *
+ * This function textures the floor on the next frame if the image is in
+ * the texture cache. Otherwise it starts loading the image on a worker
+ * thread. The floor keeps its current texture until the new one has been
+ * uploaded, which happens on the first frame after decoding finishes.
+ *
+ * @param imageFileName the name of the image file that contains the texture data.
+ */
+void GLWidget::enableFloorTexture(const QString &imageFileName){
+
+	floorTextureFile = imageFileName;
+	state.floorTextureKey = TextureCache::key(imageFileName);
+	state.floorTextureImage = TextureImage();
+
+	if(textureCache.contains(state.floorTextureKey)){
+		floorTextureLoading = false;
+		scheduleRepaint();
 		return;
 	}
-		
 
-	QImage glImage = QGLWidget::convertToGLFormat(image);
-	
-	glBindTexture(GL_TEXTURE_2D,textures[0]);  
-	glTexImage2D(GL_TEXTURE_2D,0,GL_RGB, glImage.width(),glImage.height(),0, 
-				 GL_RGBA,GL_UNSIGNED_BYTE, glImage.bits());
+	floorTextureLoading = true;
+	loadTexture(floorTextureWatcher, imageFileName);
+}
 
+/** 
+ * @brief Load texture.
+ *
+ * This function starts decoding an image on a worker thread, in the format
+ * the GL takes. Until initializeGL() has published what the GL takes, the
+ * decoding is deferred to loadDeferredTextures().
+ *
+ * @param watcher the watcher notified when the image is decoded.
+ * @param imageFileName the name of the image file.
+ */
+void GLWidget::loadTexture(QFutureWatcher<TextureImage> *watcher, const QString &imageFileName){
+
+	capabilitiesMutex.lock();
+	bool published = capabilitiesPublished;
+	TextureCapabilities gl = capabilities;
+	capabilitiesMutex.unlock();
+
+	if(!published){
+		deferredTextures.insert(watcher, imageFileName);
+		return;
+	}
 
-	cubeTexturing = true;
-	updateGL();
+	deferredTextures.remove(watcher);
+	watcher->setFuture(QtConcurrent::run(loadTextureImage, imageFileName,
+										 !gl.npot, gl.maxSize, gl.compressed));
 }
 
 /** 
- * @brief Enable the floor texture
+ * @brief Load deferred textures.
  *
- * This function activates the texturing for the floor by loading the image texture
- * and setting the appropiates variables to enable the texturing mode on the floor. 
+ * Starts decoding the images requested before the GL was initialized.
+ * Queued by initializeGL(), which may run on the render thread.
+ * 
+ */
+void GLWidget::loadDeferredTextures(){
+
+	QHash<QFutureWatcher<TextureImage> *, QString> deferred = deferredTextures;
+	deferredTextures.clear();
+
+	QHash<QFutureWatcher<TextureImage> *, QString>::const_iterator texture;
+	for(texture = deferred.constBegin(); texture != deferred.constEnd(); ++texture){
+		//Withdrawn meanwhile by disableCubeTexture() or disableFloorTexture().
+		if((texture.key() == cubeTextureWatcher) ? !cubeTextureLoading : !floorTextureLoading)
+			continue;
+		loadTexture(texture.key(), texture.value());
+	}
+}
+
+/** 
+ * @brief Load missing textures.
  *
- * @param imageFileName the name of the image file that contains the texture data.
+ * Called by the renderer when a texture of the scene state was evicted from
+ * the texture cache before it could be bound. Its image is decoded again.
+ * 
  */
-void GLWidget::enableFloorTexture(const QString &imageFileName){
+void GLWidget::loadMissingTextures(){
 
-	QImage image;
+	if(!state.cubeTextureKey.isEmpty() && state.cubeTextureImage.isNull()
+	   && !cubeTextureLoading && !textureCache.contains(state.cubeTextureKey)){
+		cubeTextureLoading = true;
+		loadTexture(cubeTextureWatcher, cubeTextureFile);
+	}
 
-	if(!image.load(imageFileName)){
-		QMessageBox::warning(this,
-							 "Load Image Error", 
-							 "Loading image for floor texturing was impossible");
-		emit(floorTexturingFailed());
+	if(!state.floorTextureKey.isEmpty() && state.floorTextureImage.isNull()
+	   && !floorTextureLoading && !textureCache.contains(state.floorTextureKey)){
+		floorTextureLoading = true;
+		loadTexture(floorTextureWatcher, floorTextureFile);
+	}
+}
+
+/** 
+ * @brief Cube texture loaded.
+ *
+ * This function receives the decoded cube texture. On success the image is
+ * passed on with the scene state for the next frame to upload it;
+ * otherwise the user is warned, the cube is left untextured and
+ * cubeTexturingFailed() is emitted.
+ * 
+ */
+void GLWidget::cubeTextureLoaded(){
+
+	//The request was withdrawn by disableCubeTexture().
+	if(!cubeTextureLoading)
+		return;
+
+	cubeTextureLoading = false;
+	TextureImage texture = cubeTextureWatcher->result();
+
+	if(texture.status == TextureImage::LoadError){
+		if(loadWarnings)
+			QMessageBox::warning(this,
+								 "Load Image Error", 
+								 "Loading image for cube texturing was impossible");
+		disableCubeTexture();
+		emit(cubeTexturingFailed());
 		return;
 	}
 
-	if( (image.width()!= 256 && image.height() != 512)
-		|| image.width() != image.height()){
-		
-		QMessageBox::warning(this,
-							 "Image Size Error", 
-							 "The image must be 256x256 or 512x512");
+	state.cubeTextureImage = texture;
+	scheduleRepaint();
+}
+
+/** 
+ * @brief Floor texture loaded.
+ *
+ * This function receives the decoded floor texture. On success the image is
+ * passed on with the scene state for the next frame to upload it;
+ * otherwise the user is warned, the floor is left untextured and
+ * floorTexturingFailed() is emitted.
+ * 
+ */
+void GLWidget::floorTextureLoaded(){
+
+	//The request was withdrawn by disableFloorTexture().
+	if(!floorTextureLoading)
+		return;
+
+	floorTextureLoading = false;
+	TextureImage texture = floorTextureWatcher->result();
+
+	if(texture.status == TextureImage::LoadError){
+		if(loadWarnings)
+			QMessageBox::warning(this,
+								 "Load Image Error", 
+								 "Loading image for floor texturing was impossible");
+		disableFloorTexture();
 		emit(floorTexturingFailed());
 		return;
 	}
-		
 
-	QImage glImage = QGLWidget::convertToGLFormat(image);
+	state.floorTextureImage = texture;
+	scheduleRepaint();
+}
+
+/** 
+ * @brief Upload texture.
+ *
+ * This function uploads a decoded image into a texture object and builds
+ * its mipmap chain on the GPU. When pixel buffer objects are available
+ * the pixels are staged in one, so the transfer to the GL does not block
+ * on the copy.
+ *
+ * @param texture the texture object.
+ * @param image the image, already in GL format.
+ */
+void GLWidget::uploadTexture(GLuint texture, const QImage &image){
+
+	const GLvoid *pixels = image.bits();
+
+	if(pixelBuffers){
+		textureUploadBuffer.bind();
+		textureUploadBuffer.allocate(image.byteCount());
+
+		void *staging = textureUploadBuffer.map(QGLBuffer::WriteOnly);
+		if(staging){
+			memcpy(staging, image.bits(), image.byteCount());
+			textureUploadBuffer.unmap();
+			pixels = 0;
+		}
+		else
+			textureUploadBuffer.release();
+	}
+
+	glState.bindTexture(texture);
+	if(!mipmapGeneration)
+		glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
+	glTexImage2D(GL_TEXTURE_2D,0,GL_RGB, image.width(),image.height(),0, 
+				 GL_RGBA,GL_UNSIGNED_BYTE, pixels);
+	if(mipmapGeneration)
+		glFunctions.glGenerateMipmap(GL_TEXTURE_2D);
 
-	
-	glBindTexture(GL_TEXTURE_2D,textures[1]);  	
-	glTexImage2D(GL_TEXTURE_2D,0,GL_RGB, glImage.width(),glImage.height(),0, 
-				 GL_RGBA,GL_UNSIGNED_BYTE, glImage.bits());
+	if(pixelBuffers && !pixels)
+		textureUploadBuffer.release();
+}
+
+/** 
+ * @brief Upload compiled texture.
+ *
+ * This function uploads the levels of a KTX file straight from the mapped
+ * file. When the file has no mipmaps they are built on the GPU.
+ *
+ * @param texture the texture object.
+ * @param ktx the KTX file, already checked by the texture loader.
+ */
+void GLWidget::uploadCompiledTexture(GLuint texture, const KtxFile &ktx){
+
+	const QList<KtxFile::Level> &levels = ktx.levels();
+	bool generate = levels.size() == 1 && !ktx.isCompressed();
+
+	glState.bindTexture(texture);
+	if(!generate)
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels.size() - 1);
+	else if(!mipmapGeneration)
+		glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
+
+	for(int i = 0; i < levels.size(); i++){
+		if(ktx.isCompressed())
+			glFunctions.glCompressedTexImage2D(GL_TEXTURE_2D, i, ktx.glInternalFormat(),
+											   levels[i].width, levels[i].height, 0,
+											   levels[i].size, levels[i].data);
+		else
+			glTexImage2D(GL_TEXTURE_2D, i, ktx.glInternalFormat(),
+						 levels[i].width, levels[i].height, 0,
+						 ktx.glFormat(), ktx.glType(), levels[i].data);
+	}
 
-	floorTexturing = true;
-	updateGL();
+	if(generate && mipmapGeneration)
+		glFunctions.glGenerateMipmap(GL_TEXTURE_2D);
 }
 
 /** 
  * @brief Disable cube texturing.
  *
- * This function sets the cube texturing variable off and updates the scene.
+ * This function leaves the cube untextured from the next frame on and
+ * discards any texture still being loaded for it. The texture stays in the
+ * texture cache, so enabling it again is immediate.
  * 
  */
 void GLWidget::disableCubeTexture(){
 
-	cubeTexturing = false;
-	updateGL();
+	cubeTextureLoading = false;
+	state.cubeTextureKey.clear();
+	state.cubeTextureImage = TextureImage();
+	scheduleRepaint();
 }
 
 /** 
  * @brief Disable floor texturing.
  *
- * This function sets the floor texturing variable off and updates the scene.
+ * This function leaves the floor untextured from the next frame on and
+ * discards any texture still being loaded for it. The texture stays in the
+ * texture cache, so enabling it again is immediate.
  * 
  */
 void GLWidget::disableFloorTexture(){
 
-	floorTexturing = false;
-	updateGL();
+	floorTextureLoading = false;
+	state.floorTextureKey.clear();
+	state.floorTextureImage = TextureImage();
+	scheduleRepaint();
 }
 
 /** 
@@ -664,9 +2099,9 @@ void GLWidget::disableFloorTexture(){
  */
 void GLWidget::enableLighting(){
 
-	lighting = true;
-	
-	updateGL();
+	SceneState next = state;
+	next.lighting = true;
+	applySceneState(next);
 }
 
 /** 
@@ -677,9 +2112,9 @@ void GLWidget::enableLighting(){
  */
 void GLWidget::disableLighting(){
 
-	lighting = false;
-	
-	updateGL();	
+	SceneState next = state;
+	next.lighting = false;
+	applySceneState(next);
 }
 
 /** 
@@ -692,12 +2127,9 @@ void GLWidget::disableLighting(){
  */
 void GLWidget::setReflection(bool activation){
 
-	if(activation)
-		reflection = true;
-	else
-		reflection = false;
-
-	updateGL();
+	SceneState next = state;
+	next.reflection = activation;
+	applySceneState(next);
 }
 
 /** 
@@ -724,24 +2156,9 @@ void GLWidget::setLighting(bool activation){
  */
 void GLWidget::setFog(bool activation){
 
-	if(activation){
-		fog=true;
-		glEnable(GL_FOG);
-		qglClearColor(QColor::fromRgbF(fogColor[0],
-									   fogColor[1],
-									   fogColor[2]));
-	}
-	else{
-		fog = false;
-		glDisable(GL_FOG);
-		qglClearColor(QColor::fromRgbF(0,0,0));
-									   
-	}
-
-	
-	glFogfv(GL_FOG_COLOR, fogColor);				  
-	
-	updateGL();
+	SceneState next = state;
+	next.fog = activation;
+	applySceneState(next);
 }
 
 /** 
@@ -753,21 +2170,10 @@ void GLWidget::setFog(bool activation){
  * @param value new value for the red component of the fog effect.
  */
 void GLWidget::setFogRedComponent(int value){
-  
-    if(value<0 || value>255)
-		fogColor[0] = 0;
-    else
-		fogColor[0] = value/256.0f;
 
-	if(fog){
-	
-		qglClearColor(QColor::fromRgbF(fogColor[0],
-									   fogColor[1],
-									   fogColor[2]));
-		
-		glFogfv(GL_FOG_COLOR, fogColor);				  
-		updateGL();
-	}
+	SceneState next = state;
+	next.fogColor[0] = colorComponent(value);
+	applySceneState(next);
 }
 
 /** 
@@ -779,20 +2185,10 @@ void GLWidget::setFogRedComponent(int value){
  * @param value new value for the green component of the fog effect.
  */
 void GLWidget::setFogGreenComponent(int value){
-	
-	if(value<0 || value>255)
-		fogColor[1] = 0;
-	else
-		fogColor[1] = value/256.0f;
-	
-	if(fog){
-	
-		qglClearColor(QColor::fromRgbF(fogColor[0],
-									   fogColor[1],
-									   fogColor[2]));
-		glFogfv(GL_FOG_COLOR, fogColor);				  
-		updateGL();  
-	}
+
+	SceneState next = state;
+	next.fogColor[1] = colorComponent(value);
+	applySceneState(next);
 }
 
 /** 
@@ -804,20 +2200,28 @@ void GLWidget::setFogGreenComponent(int value){
  * @param value new value for the blue component of the fog effect.
  */
 void GLWidget::setFogBlueComponent(int value){
-  
-	
-	if(value<0 || value>255)
-		fogColor[2] = 0;
-	else
-		fogColor[2] = value/256.0f;
-	
-	if(fog){	
-		qglClearColor(QColor::fromRgbF(fogColor[0],
-									   fogColor[1],
-									   fogColor[2]));
-		glFogfv(GL_FOG_COLOR, fogColor);
-		updateGL();
-	}
+
+	SceneState next = state;
+	next.fogColor[2] = colorComponent(value);
+	applySceneState(next);
+}
+
+/** 
+ * @brief Set the fog color.
+ *
+ * This function sets the three components of the fog color at once.
+ *
+ * @param red new value for the red component, 0-255.
+ * @param green new value for the green component, 0-255.
+ * @param blue new value for the blue component, 0-255.
+ */
+void GLWidget::setFogColor(int red, int green, int blue){
+
+	SceneState next = state;
+	next.fogColor[0] = colorComponent(red);
+	next.fogColor[1] = colorComponent(green);
+	next.fogColor[2] = colorComponent(blue);
+	applySceneState(next);
 }
 
 /** 
@@ -829,9 +2233,9 @@ void GLWidget::setFogBlueComponent(int value){
  */
 void GLWidget::setFogStart(int value){
 
-	glFogf(GL_FOG_START, (float) value);
-
-	updateGL();
+	SceneState next = state;
+	next.fogStart = (float) value;
+	applySceneState(next);
 }
 
 /** 
@@ -843,215 +2247,463 @@ void GLWidget::setFogStart(int value){
  */
 void GLWidget::setFogEnd(int value){
 
-	glFogf(GL_FOG_END, (float) value);
+	SceneState next = state;
+	next.fogEnd = (float) value;
+	applySceneState(next);
+}
+
+/** 
+ * @brief Set profiling.
+ *
+ * This function turns the frame profiler on or off. While it is on, the
+ * CPU and GPU time of every pass is printed to stderr once per second.
+ *
+ * @param enable whether frames are profiled.
+ */
+void GLWidget::setProfiling(bool enable){
 
-	updateGL();
+	SceneState next = state;
+	next.profiling = enable;
+	applySceneState(next);
 }
 
 /** 
- * @brief Draw a cube.
+ * @brief Set instances.
  *
- * This function draws a cube taking in account the configuration
- * for the cube given by the parameters represented through the internal
- * variables of the class.
+ * This function replaces the cube with a lattice of count cubes, drawn
+ * with a single instanced call, or goes back to the single cube if count
+ * is 0. While the lattice is shown frames are rendered continuously and
+ * instanceThroughputChanged() is emitted every second.
+ *
+ * @param count number of cubes of the lattice.
+ */
+void GLWidget::setInstances(int count){
+
+	SceneState next = state;
+	next.instances = count;
+	applySceneState(next);
+}
+
+/** 
+ * @brief Draw cube node.
+ *
+ * This function draws the cube.
  * 
+ * @param world the world matrix of the cube node.
  */
-void GLWidget::drawCube(){
+template<bool Lighting, bool Texturized>
+void GLWidget::drawCubeNode(const GLfloat *world){
 
-    glPolygonMode(GL_FRONT_AND_BACK,GL_FILL);
-    glEnable(GL_POLYGON_OFFSET_FILL);
-    glPolygonOffset(1.0f, 1.0f);
-    glColor3ub(cubeRedComponent, cubeGreenComponent, cubeBlueComponent);
-	
-	glBegin(GL_QUADS);
-    //Front Face
-    glNormal3f(0.0f,0.0f,1.0f);
-	glVertex3f(1,-1,1);
-    glVertex3f(1,1,1);
-    glVertex3f(-1,1,1);
-    glVertex3f(-1,-1,1);  
-   
-	 //Back Face
-    glNormal3f(0.0f,0.0f,-1.0f);
-    glVertex3f(-1,-1,-1);
-    glVertex3f(-1,1,-1);
-    glVertex3f(1,1,-1);
-    glVertex3f(1,-1,-1);
-  
-	//Left Face
-    glNormal3f(-1.0f,0.0f,0.0f);
-    glVertex3f(-1,-1,1);
-    glVertex3f(-1,1,1);
-    glVertex3f(-1,1,-1); 
-    glVertex3f(-1,-1,-1);  
-   
-    //Right Face
-    glNormal3f(1.0f,0.0f,0.0f);
-    glVertex3f(1,-1,-1);
-    glVertex3f(1,1,-1);
-    glVertex3f(1,1,1);
-    glVertex3f(1,-1,1);
-  
-    //Top Face
-	glNormal3f(0.0f,1.0f,0.0f);
-    glVertex3f(1,1,1);
-    glVertex3f(1,1,-1);
-    glVertex3f(-1,1,-1);
-    glVertex3f(-1,1,1);
-
-    //Bottom Face
-    glNormal3f(0.0f,-1.0f,0.0f);
-    glVertex3f(-1,-1,1);
-    glVertex3f(-1,-1,-1);
-    glVertex3f(1,-1,-1);
-    glVertex3f(1,-1,1);
-    glEnd(); //GL_QUADS
-
-    glDisable(GL_POLYGON_OFFSET_FILL);
-
-    glPolygonMode(GL_FRONT_AND_BACK,GL_LINE);
-    glColor3ub(255-cubeRedComponent, 255-cubeGreenComponent, 255-cubeBlueComponent);
-    glBegin(GL_QUADS);
-    //Front Face
-    glVertex3f(1,-1,1);
-    glVertex3f(1,1,1);
-    glVertex3f(-1,1,1);
-    glVertex3f(-1,-1,1);
-  
-    //Back Face
-    glVertex3f(-1,-1,1);
-    glVertex3f(-1,1,1);
-    glVertex3f(-1,1,-1); 
-    glVertex3f(-1,-1,-1);
-  
-    //Left Face
-    glVertex3f(-1,-1,-1);
-    glVertex3f(-1,1,-1);
-    glVertex3f(1,1,-1);
-    glVertex3f(1,-1,-1);
-  
-    //Right Face
-    glVertex3f(1,-1,-1);
-    glVertex3f(1,1,-1);
-    glVertex3f(1,1,1);
-    glVertex3f(1,-1,1);
-  
-    //Top Face
-    glVertex3f(1,1,1);
-    glVertex3f(1,1,-1);
-    glVertex3f(-1,1,-1);
-    glVertex3f(-1,1,1);
+	profiler.beginPass(FrameProfiler::Cube);
+
+	glState.lightfv(GL_LIGHT1, GL_POSITION, lightPosition);
+
+	beginNode(cubeVariant<Lighting, Texturized>(), world);
+	drawCube<Texturized>();
+	endNode();
+}
+
+/** 
+ * @brief Draw lattice node.
+ *
+ * This function draws the cube lattice in place of the cube.
+ * 
+ * @param world the world matrix of the cube node.
+ */
+void GLWidget::drawLatticeNode(const GLfloat *world){
+
+	profiler.beginPass(FrameProfiler::Cube);
+
+	glState.lightfv(GL_LIGHT1, GL_POSITION, lightPosition);
+
+	//The lattice multiplies the transforms of its cubes onto the GL model
+	//view matrix, so it is lit and fogged by the fixed function (or by its
+	//own program, which reads the fixed function state).
+	if(shading){
+		sceneShaders.release();
+		glState.setEnabled(GL_LIGHT1, frame.lighting);
+		glState.setEnabled(GL_NORMALIZE, frame.lighting);
+		glState.setEnabled(GL_LIGHTING, frame.lighting);
+		glState.setEnabled(GL_FOG, frame.fog);
+	}
+
+	glPushMatrix();
+	glLoadMatrixf(world);
+	drawInstancedCubes();
+	glPopMatrix();
+
+	if(shading){
+		glState.disable(GL_LIGHT1);
+		glState.disable(GL_NORMALIZE);
+		glState.disable(GL_LIGHTING);
+		glState.disable(GL_FOG);
+	}
+}
+
+/** 
+ * @brief Draw reflection node.
+ *
+ * This function draws the reflection of the cube. With a reflection buffer
+ * the cached reflection is only rendered again when the cube changes, and
+ * laid under the cube drawn before.
+ * 
+ * @param world the world matrix of the reflection node.
+ */
+template<bool Lighting, bool Texturized>
+void GLWidget::drawReflectionNode(const GLfloat *world){
+
+	profiler.beginPass(FrameProfiler::Reflection);
+
+	if(!reflectionBuffer){
+		drawReflectedCube<Lighting, Texturized>(world);
+		return;
+	}
+
+	if(reflectionDirty)
+		renderReflection<Lighting, Texturized>(world);
+
+	drawReflection();
+}
+
+/** 
+ * @brief Begin floor pass.
+ *
+ * This function sets up the blending of the translucent floor.
+ * 
+ */
+void GLWidget::beginFloorPass(){
+
+	profiler.beginPass(FrameProfiler::Blend);
+
+	glState.disable(GL_LIGHTING);
+	glState.disable(GL_POLYGON_OFFSET_FILL);
+
+	glState.enable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	profiler.beginPass(FrameProfiler::Floor);
+}
+
+/** 
+ * @brief Update scene parameters.
+ *
+ * This function writes the light and fog settings of the frame to the
+ * parameter block of the programs. The light positions are given in eye
+ * coordinates, as the fixed function pipeline stores them.
+ * 
+ */
+void GLWidget::updateSceneParameters(){
+
+	SceneShaders::Parameters parameters;
+
+	for(int i = 0; i < 4; i++){
+		parameters.ambientLight[i] = frame.ambientLight[i];
+		parameters.diffuseLight[i] = frame.diffuseLight[i];
+		parameters.fogColor[i] = frame.fogColor[i];
+	}
+
+	//Default ambient light of the light model.
+	parameters.lightModelAmbient[0] = 0.2f;
+	parameters.lightModelAmbient[1] = 0.2f;
+	parameters.lightModelAmbient[2] = 0.2f;
+	parameters.lightModelAmbient[3] = 1.0f;
+
+	parameters.fogEnd = frame.fogEnd;
+	parameters.fogScale = frame.fogEnd != frame.fogStart
+		? 1.0f/(frame.fogEnd - frame.fogStart) : 1.0f;
+	parameters.fog = frame.fog ? 1.0f : 0.0f;
+	parameters.padding = 0.0f;
+	memcpy(parameters.projection, projectionMatrix.data(), sizeof(parameters.projection));
+
+	SceneShaders::Parameters mirrored = parameters;
+
+	for(int i = 0; i < 4; i++){
+		parameters.lightPosition[i] = lightPosition[i];
+		mirrored.lightPosition[i] = lightPositionMirror[i];
+	}
+
+	sceneShaders.setParameters(parameters, mirrored);
+}
+
+/** 
+ * @brief Begin node.
+ *
+ * This function sets up the drawing of a node: it makes a program of the
+ * scene current and hands it the model view matrix of the node or, with
+ * the fixed function pipeline, loads that matrix. Must be paired with
+ * endNode().
+ * 
+ * @param variant the program.
+ * @param world the world matrix of the node, view included.
+ * @param mirrored whether the light is mirrored for the reflection.
+ */
+void GLWidget::beginNode(SceneShaders::Variant variant, const GLfloat *world, bool mirrored){
+
+	if(shading){
+		sceneShaders.bind(variant, mirrored);
+		sceneShaders.setModelView(world);
+		return;
+	}
+
+	glPushMatrix();
+	glLoadMatrixf(world);
+}
+
+/** 
+ * @brief End node.
+ *
+ * This function restores the model view matrix after beginNode().
+ * 
+ */
+void GLWidget::endNode(){
+
+	if(!shading)
+		glPopMatrix();
+}
+
+/** 
+ * @brief Draw floor node.
+ *
+ * @param world the world matrix of the floor node.
+ */
+void GLWidget::drawFloorNode(const GLfloat *world){
+
+	beginFloorPass();
+	glState.disable(GL_TEXTURE_2D);
+
+	beginNode(SceneShaders::Plain, world);
+	drawFloor();
+	endNode();
+}
+
+/** 
+ * @brief Draw texturized floor node.
+ *
+ * @param world the world matrix of the texturized floor node.
+ */
+void GLWidget::drawTexturizedFloorNode(const GLfloat *world){
+
+	beginFloorPass();
+	glState.enable(GL_TEXTURE_2D);
+	glState.bindTexture(floorTexture);
+
+	beginNode(SceneShaders::Textured, world);
+	drawTexturizedFloor();
+	endNode();
+}
+
+/** 
+ * @brief Draw reflected cube.
+ *
+ * This function draws the cube mirrored through the floor plane, with
+ * the light mirrored as well.
+ * 
+ * @param world the world matrix of the reflection node.
+ */
+template<bool Lighting, bool Texturized>
+void GLWidget::drawReflectedCube(const GLfloat *world){
+
+	glFrontFace(GL_CW);
+	glState.lightfv(GL_LIGHT1, GL_POSITION, lightPositionMirror);
+
+	beginNode(cubeVariant<Lighting, Texturized>(), world, true);
+	drawCube<Texturized>();
+	endNode();
+
+	glFrontFace(GL_CCW);
+}
+
+/** 
+ * @brief Render reflection.
+ *
+ * This function renders the reflected cube into the reflection buffer,
+ * over the clear color, and goes back to the framebuffer that was bound
+ * (which is not always the window, e.g. in the benchmark).
+ * 
+ * @param world the world matrix of the reflection node.
+ */
+template<bool Lighting, bool Texturized>
+void GLWidget::renderReflection(const GLfloat *world){
+
+	GLint framebuffer = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+
+	glFunctions.glBindFramebuffer(GL_FRAMEBUFFER, reflectionBuffer->handle());
+	glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+	drawReflectedCube<Lighting, Texturized>(world);
+	glFunctions.glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+	reflectionDirty = false;
+}
+
+/** 
+ * @brief Draw reflection.
+ *
+ * This function lays the cached reflection over the whole viewport at the
+ * far plane, so it only shows where nothing has been drawn yet and the
+ * translucent floor is blended over it.
+ * 
+ */
+void GLWidget::drawReflection(){
+
+	static const GLfloat corners[4][4] = {
+		{-1.0f, -1.0f, 0.0f, 0.0f},
+		{ 1.0f, -1.0f, 1.0f, 0.0f},
+		{ 1.0f,  1.0f, 1.0f, 1.0f},
+		{-1.0f,  1.0f, 0.0f, 1.0f}
+	};
+
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+
+	glDepthRange(1.0, 1.0);
+	glDepthFunc(GL_LEQUAL);
 
-    //Bottom Face
-    glVertex3f(-1,-1,1);
-    glVertex3f(-1,-1,-1);
-    glVertex3f(1,-1,-1);
-    glVertex3f(1,-1,1);
-    glEnd(); //GL_QUADS
+	//The buffer was already lit and fogged when it was rendered.
+	if(shading)
+		sceneShaders.release();
+	glState.disable(GL_LIGHTING);
+	glState.disable(GL_POLYGON_OFFSET_FILL);
+	glState.disable(GL_FOG);
+	glState.enable(GL_TEXTURE_2D);
+	glState.bindTexture(reflectionBuffer->texture());
+	glState.polygonMode(GL_FILL);
+	glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
 
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glVertexPointer(2, GL_FLOAT, sizeof(corners[0]), &corners[0][0]);
+	glTexCoordPointer(2, GL_FLOAT, sizeof(corners[0]), &corners[0][2]);
+
+	glDrawArrays(GL_QUADS, 0, 4);
+
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+
+	glState.setEnabled(GL_FOG, frame.fog && !shading);
+	glDepthFunc(GL_LESS);
+	glDepthRange(0.0, 1.0);
+
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+}
+
+/** 
+ * @brief Draw instanced cubes.
+ *
+ * This function draws the cube lattice, filled and untextured, from the
+ * cube vertex arrays.
+ * 
+ */
+void GLWidget::drawInstancedCubes(){
+
+	glState.disable(GL_TEXTURE_2D);
+	glState.polygonMode(GL_FILL);
+
+	setCubeArrays(false);
+	instancedCubes.draw(frame.lighting, frame.fog);
+
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+
+	if(vertexBuffers)
+		cubeVertexBuffer.release();
+}
+
+/** 
+ * @brief Set cube arrays.
+ *
+ * This function points the vertex arrays to the filled cube geometry.
+ * 
+ * @param texturized whether the texture coordinates are used.
+ */
+void GLWidget::setCubeArrays(bool texturized){
+
+	const char *base = (const char *)cubeVertices;
+
+	if(vertexBuffers){
+		cubeVertexBuffer.bind();
+		base = 0;
+	}
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glVertexPointer(3, GL_FLOAT, sizeof(CubeVertex),
+					base + offsetof(CubeVertex, position));
+	glNormalPointer(GL_FLOAT, sizeof(CubeVertex),
+					base + offsetof(CubeVertex, normal));
+
+	if(texturized){
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		glTexCoordPointer(2, GL_FLOAT, sizeof(CubeVertex),
+						  base + offsetof(CubeVertex, texCoord));
+	}
+}
+
+/** 
+ * @brief Draw the cube outline.
+ *
+ * This function draws the edges of the cube in the inverse of the cube
+ * color. The normal (and texture coordinate) left by the last filled face
+ * are kept, as the outline has none of its own.
+ * 
+ */
+template<bool Texturized>
+void GLWidget::drawCubeOutline(){
+
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glNormal3f(0.0f,-1.0f,0.0f);
+	if(Texturized){
+		glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+		glTexCoord2f(0.0f, 0.0f);
+	}
+
+    glState.polygonMode(GL_LINE);
+    glColor3ub(255-frame.cubeColor[0], 255-frame.cubeColor[1], 255-frame.cubeColor[2]);
+
+	if(vertexBuffers){
+		cubeOutlineVertexBuffer.bind();
+		glVertexPointer(3, GL_FLOAT, 0, 0);
+		cubeOutlineIndexBuffer.bind();
+		glDrawElements(GL_QUADS, 24, GL_UNSIGNED_BYTE, 0);
+		cubeOutlineIndexBuffer.release();
+		cubeOutlineVertexBuffer.release();
+	}
+	else{
+		glVertexPointer(3, GL_FLOAT, 0, cubeCorners);
+		glDrawElements(GL_QUADS, 24, GL_UNSIGNED_BYTE, cubeOutlineIndices);
+	}
+
+	glDisableClientState(GL_VERTEX_ARRAY);
 }
 
 /** 
- * @brief Draw a texturized cube.
+ * @brief Draw a cube.
  *
- * This function draws a texturized cube taking in account the configuration
+ * This function draws a cube taking in account the configuration
  * for the cube given by the parameters represented through the internal
- * variables of the class.
+ * variables of the class. The texture, if any, is already bound.
  * 
  */
-void GLWidget::drawTexturizedCube(){
+template<bool Texturized>
+void GLWidget::drawCube(){
 
-    glPolygonMode(GL_FRONT_AND_BACK,GL_FILL);
-    glEnable(GL_POLYGON_OFFSET_FILL);
-    glPolygonOffset(1.0f, 1.0f);
-    glColor3ub(cubeRedComponent, cubeGreenComponent, cubeBlueComponent);
-	
-	glBegin(GL_QUADS);
-    //Front Face
-    glNormal3f(0.0f,0.0f,1.0f);
-	glTexCoord2f(1.0f, 0.0f); glVertex3f(1,-1,1);
-	glTexCoord2f(1.0f, 1.0f); glVertex3f(1,1,1);
-    glTexCoord2f(0.0f, 1.0f); glVertex3f(-1,1,1);
-    glTexCoord2f(0.0f, 0.0f); glVertex3f(-1,-1,1);  
-   
-	 //Back Face
-    glNormal3f(0.0f,0.0f,-1.0f);
-    glTexCoord2f(1.0f, 0.0f); glVertex3f(-1,-1,-1);
-    glTexCoord2f(1.0f, 1.0f); glVertex3f(-1,1,-1);
-    glTexCoord2f(0.0f, 1.0f); glVertex3f(1,1,-1);
-    glTexCoord2f(0.0f, 0.0f); glVertex3f(1,-1,-1);
-  
-	//Left Face
-    glNormal3f(-1.0f,0.0f,0.0f);
-    glTexCoord2f(1.0f, 0.0f); glVertex3f(-1,-1,1);
-    glTexCoord2f(1.0f, 1.0f); glVertex3f(-1,1,1);
-    glTexCoord2f(0.0f, 1.0f); glVertex3f(-1,1,-1); 
-    glTexCoord2f(0.0f, 0.0f); glVertex3f(-1,-1,-1);  
-   
-    //Right Face
-    glNormal3f(1.0f,0.0f,0.0f);
-    glTexCoord2f(1.0f, 0.0f); glVertex3f(1,-1,-1);
-    glTexCoord2f(1.0f, 1.0f); glVertex3f(1,1,-1);
-    glTexCoord2f(0.0f, 1.0f); glVertex3f(1,1,1);
-    glTexCoord2f(0.0f, 0.0f); glVertex3f(1,-1,1);
-  
-    //Top Face
-	glNormal3f(0.0f,1.0f,0.0f);
-    glTexCoord2f(1.0f, 0.0f); glVertex3f(1,1,1);
-    glTexCoord2f(1.0f, 1.0f); glVertex3f(1,1,-1);
-    glTexCoord2f(0.0f, 1.0f); glVertex3f(-1,1,-1);
-    glTexCoord2f(0.0f, 0.0f); glVertex3f(-1,1,1);
-
-    //Bottom Face
-    glNormal3f(0.0f,-1.0f,0.0f);
-    glTexCoord2f(1.0f, 0.0f); glVertex3f(-1,-1,1);
-    glTexCoord2f(1.0f, 1.0f); glVertex3f(-1,-1,-1);
-    glTexCoord2f(0.0f, 1.0f); glVertex3f(1,-1,-1);
-    glTexCoord2f(0.0f, 0.0f); glVertex3f(1,-1,1);
-    glEnd(); //GL_QUADS
-
-    glDisable(GL_POLYGON_OFFSET_FILL);
-
-    glPolygonMode(GL_FRONT_AND_BACK,GL_LINE);
-    glColor3ub(255-cubeRedComponent, 255-cubeGreenComponent, 255-cubeBlueComponent);
-    glBegin(GL_QUADS);
-    //Front Face
-    glVertex3f(1,-1,1);
-    glVertex3f(1,1,1);
-    glVertex3f(-1,1,1);
-    glVertex3f(-1,-1,1);
-  
-    //Back Face
-    glVertex3f(-1,-1,1);
-    glVertex3f(-1,1,1);
-    glVertex3f(-1,1,-1); 
-    glVertex3f(-1,-1,-1);
-  
-    //Left Face
-    glVertex3f(-1,-1,-1);
-    glVertex3f(-1,1,-1);
-    glVertex3f(1,1,-1);
-    glVertex3f(1,-1,-1);
-  
-    //Right Face
-    glVertex3f(1,-1,-1);
-    glVertex3f(1,1,-1);
-    glVertex3f(1,1,1);
-    glVertex3f(1,-1,1);
-  
-    //Top Face
-    glVertex3f(1,1,1);
-    glVertex3f(1,1,-1);
-    glVertex3f(-1,1,-1);
-    glVertex3f(-1,1,1);
+    glState.polygonMode(GL_FILL);
+	//The offset only applies to filled polygons, so it can stay enabled
+	//for the outline; the floor pass disables it.
+    glState.enable(GL_POLYGON_OFFSET_FILL);
+    glColor3ub(frame.cubeColor[0], frame.cubeColor[1], frame.cubeColor[2]);
 
-    //Bottom Face
-    glVertex3f(-1,-1,1);
-    glVertex3f(-1,-1,-1);
-    glVertex3f(1,-1,-1);
-    glVertex3f(1,-1,1);
-    glEnd(); //GL_QUADS
+	setCubeArrays(Texturized);
+	glDrawArrays(GL_QUADS, 0, 24);
 
+	drawCubeOutline<Texturized>();
 }
 
 /** 
@@ -1064,24 +2716,29 @@ void GLWidget::drawTexturizedCube(){
  */
 void GLWidget::drawFloor(){
 
-	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-	
-	for(int i=-50; i<50; i++){
- 		for(int j=-50; j<50; j++){
+	glState.polygonMode(GL_FILL);
 
-			if((i+j)%2)
-				glColor4f(1.0f, 1.0f, 1.0f, 0.8f);
-			else
-				glColor4f(0.0f, 0.0f, 0.0f, 0.8f);
-
-			glBegin(GL_QUADS);
-			glVertex3f(i+1, j, 0.0f);
-			glVertex3f(i+1, j+1, 0.0f);
-			glVertex3f(i, j+1, 0.0f);
-			glVertex3f(i, j, 0.0f);
-			glEnd();			
-		}		
+	const char *base = floorVertexData.constData();
+
+	if(vertexBuffers){
+		floorVertexBuffer.bind();
+		base = 0;
 	}
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glVertexPointer(2, GL_FLOAT, sizeof(FloorVertex),
+					base + offsetof(FloorVertex, position));
+	glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(FloorVertex),
+				   base + offsetof(FloorVertex, color));
+
+	glDrawArrays(GL_QUADS, 0, floorTiles*floorTiles*4);
+
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+
+	if(vertexBuffers)
+		floorVertexBuffer.release();
 }
 
 /** 
@@ -1094,20 +2751,29 @@ void GLWidget::drawFloor(){
  */
 void GLWidget::drawTexturizedFloor(){
 
-	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	glState.polygonMode(GL_FILL);
 	
 	glColor4f(1.0f, 1.0f, 1.0f, 0.8f);
 
-	for(int i=-10; i<10; i++){
- 		for(int j=-10; j<10; j++){
+	const char *base = texturizedFloorVertexData.constData();
 
-			glBegin(GL_QUADS);
-			glTexCoord2f(1.0f, 0.0f); glVertex3f(i+1, j, 0.0f);
-			glTexCoord2f(1.0f, 1.0f); glVertex3f(i+1, j+1, 0.0f);
-			glTexCoord2f(0.0f, 1.0f); glVertex3f(i, j+1, 0.0f);
-			glTexCoord2f(0.0f, 0.0f); glVertex3f(i, j, 0.0f);
-			glEnd();			
-		}		
+	if(vertexBuffers){
+		texturizedFloorVertexBuffer.bind();
+		base = 0;
 	}
-}
 
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glVertexPointer(2, GL_FLOAT, sizeof(TexturizedFloorVertex),
+					base + offsetof(TexturizedFloorVertex, position));
+	glTexCoordPointer(2, GL_FLOAT, sizeof(TexturizedFloorVertex),
+					  base + offsetof(TexturizedFloorVertex, texCoord));
+
+	glDrawArrays(GL_QUADS, 0, texturizedFloorTiles*texturizedFloorTiles*4);
+
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+
+	if(vertexBuffers)
+		texturizedFloorVertexBuffer.release();
+}
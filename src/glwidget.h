@@ -32,51 +32,227 @@
 #define GLWIDGET_H
 
 #include <QGLWidget>
+#include <QGLBuffer>
+#include <QGLFunctions>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QMutex>
 #include <QtOpenGL>
 
+#include "textureloader.h"
+#include "texturecache.h"
+#include "glstatecache.h"
+#include "frameprofiler.h"
+#include "framecapture.h"
+#include "instancedcubes.h"
+#include "frustum.h"
+#include "scenenode.h"
+#include "sceneshaders.h"
+#include "programcache.h"
+#include "simdmath.h"
+#include "scenestate.h"
+
+class QTimer;
+class RenderThread;
+
 
 //!Class GLWidget.
+/*!
+ * The slots only update the scene state; every frame is rendered from a
+ * copy of it. With BASICGL_RENDER_THREAD set, frames are rendered by a
+ * RenderThread that owns the GL context.
+ *
+ * Mouse motion is accumulated between frames and applied once per frame,
+ * however many motion events arrive in between.
+ */
 class GLWidget: public QGLWidget{
   
 	Q_OBJECT;
+
+	friend class RenderThread;
   
   private:
+	//!Frame function specialized for a combination of feature switches.
+	typedef void (GLWidget::*FrameFunction)();
+
+	//!What the GL takes, which the texture decoding depends on.
+	struct TextureCapabilities{
+		bool npot;
+		int maxSize;
+		bool compressed;
+	};
+
     QPoint lastPos;
-    int xRot;
-    int yRot;
-    int zRot;
-    int cubeRedComponent;
-    int cubeGreenComponent;
-    int cubeBlueComponent;
-	float ambientLight[4];
-	float diffuseLight[4];
-	float lightPosition[4];
-	float lightPositionMirror[4];
-	float fogColor[4];
-	GLuint textures[2];
+	QPoint pendingTrackball;      //!< Left button motion not applied yet.
+	QPoint pendingTwist;          //!< Right button motion not applied yet.
+	int pendingEvents;
+	qint64 pendingInputTime;
+	QElapsedTimer inputClock;
+	QElapsedTimer motionClock;    //!< Since motion was last posted to the render thread.
+	QElapsedTimer inputReportClock;
+	int inputFrames;
+	quint64 inputEventTotal;
+	qint64 inputLatencyTotal;
+	double inputEventsAverage;
+	double inputLatencyAverage;
+	float xAngle;
+	float yAngle;
+	float zAngle;
+	SceneState state;             //!< Written by the slots.
+	SceneState frame;             //!< Rendered; only touched while rendering.
+	RenderThread *renderThread;
+	float lightPosition[4];       //!< In eye coordinates.
+	float lightPositionMirror[4]; //!< In eye coordinates.
+	GLuint cubeTexture;
+	GLuint floorTexture;
 	bool cubeTexturing;
 	bool floorTexturing;
-	bool lighting;
-	bool reflection;
-	bool fog;
+	bool vertexBuffers;
+	QGLBuffer cubeVertexBuffer;
+	QGLBuffer cubeOutlineVertexBuffer;
+	QGLBuffer cubeOutlineIndexBuffer;
+	QGLBuffer floorVertexBuffer;
+	QGLBuffer texturizedFloorVertexBuffer;
+	QByteArray floorVertexData;
+	QByteArray texturizedFloorVertexData;
+	QTimer *repaintTimer;
+	QElapsedTimer frameClock;
+	quint64 requestedRepaints;
+	quint64 renderedRepaints;
+	int changeDepth;
+	bool changesPending;
+	QFutureWatcher<TextureImage> *cubeTextureWatcher;
+	QFutureWatcher<TextureImage> *floorTextureWatcher;
+	bool cubeTextureLoading;
+	bool floorTextureLoading;
+	bool loadWarnings;
+	QString cubeTextureFile;
+	QString floorTextureFile;
+	TextureCache textureCache;
+	bool pixelBuffers;
+	bool mipmapGeneration;
+	QMutex capabilitiesMutex;
+	TextureCapabilities capabilities; //!< Guarded by capabilitiesMutex.
+	bool capabilitiesPublished;       //!< Guarded by capabilitiesMutex.
+	QHash<QFutureWatcher<TextureImage> *, QString> deferredTextures;
+	QGLFunctions glFunctions;
+	QGLBuffer textureUploadBuffer;
+	GLStateCache glState;
+	FrameProfiler profiler;
+	FrameCapture capture;
+	bool reflectionBuffers;
+	QGLFramebufferObject *reflectionBuffer;
+	bool reflectionDirty;
+	InstancedCubes instancedCubes;
+	QElapsedTimer throughputClock;
+	int throughputFrames;
+	quint64 filteredStateChanges;
+	Mat4 viewMatrix;
+	Mat4 projectionMatrix;
+	Frustum frustum;
+	SceneNode *sceneRoot;
+	SceneCallbackNode<GLWidget> *cubeNode;
+	SceneCallbackNode<GLWidget> *reflectionNode;
+	SceneNode *floorNode;
+	SceneNode *texturizedFloorNode;
+	ProgramCache programCache;
+	SceneShaders sceneShaders;
+	bool fixedFunction;
+	bool shading;
+	FrameFunction renderFrame;
     
-    inline void drawCube();
-	inline void drawTexturizedCube();
+	void scheduleRepaint();
+	void releaseUploadedImages();
+	void startRepaintTimer(const QElapsedTimer &clock);
+	void scheduleMotion();
+	void applyMotion();
+	void framePresented();
+	void requestFrame();
+	const SceneState *takeState();
+	void applyFrameState(const SceneState &next);
+	void loadTexture(QFutureWatcher<TextureImage> *watcher, const QString &imageFileName);
+	bool updateTexture(const QString &key, const TextureImage &image,
+					   QString &boundKey, GLuint &texture);
+	void uploadTexture(GLuint texture, const QImage &image);
+	void uploadCompiledTexture(GLuint texture, const KtxFile &ktx);
+	void createCubeBuffers();
+	void createFloorBuffers();
+	void setCubeArrays(bool texturized);
+	void createScene();
+	void updateCubeNodes();
+	void setAngles(float x, float y, float z);
+	void selectFramePath();
+	template<bool Lighting, bool Reflection, bool CubeTexturing, bool FloorTexturing>
+	void renderFramePath();
+	template<bool Lighting, bool Texturized> void drawCubeNode(const GLfloat *world);
+	void drawLatticeNode(const GLfloat *world);
+	template<bool Lighting, bool Texturized> void drawReflectionNode(const GLfloat *world);
+	void drawFloorNode(const GLfloat *world);
+	void drawTexturizedFloorNode(const GLfloat *world);
+	void beginFloorPass();
+	void updateSceneParameters();
+	void beginNode(SceneShaders::Variant variant, const GLfloat *world, bool mirrored = false);
+	void endNode();
+	template<bool Lighting, bool Texturized> void drawReflectedCube(const GLfloat *world);
+	template<bool Lighting, bool Texturized> void renderReflection(const GLfloat *world);
+	void drawReflection();
+	void drawInstancedCubes();
+	template<bool Texturized> void drawCubeOutline();
+	template<bool Texturized> void drawCube();
 	inline void drawFloor();
 	inline void drawTexturizedFloor();
   
   public:
 	GLWidget(QWidget *parent = 0);
+	~GLWidget();
 	QSize sizeHint() const;
 	QSize minimumSize() const;
+	quint64 repaintsRequested() const;
+	quint64 repaintsRendered() const;
+	bool texturesLoading() const;
+	quint64 textureCacheHits() const;
+	quint64 textureCacheMisses() const;
+	void setTextureCacheBudget(qint64 bytes);
+	quint64 stateChangesFiltered() const;
+	int instances() const;
+	bool shadersEnabled() const;
+	quint64 programCacheHits() const;
+	quint64 programCacheMisses() const;
+	qint64 programBuildTime() const;
+	Quat cubeOrientation() const;
+	void setCubeOrientation(const Quat &rotation);
+	SceneState sceneState() const;
+	void applySceneState(const SceneState &next);
+	void beginChanges();
+	void commitChanges();
+	void addFrameConsumer(FrameConsumer *consumer);
+	void removeFrameConsumer(FrameConsumer *consumer);
+	void flushCapture();
+	void setFrameDropping(bool enable);
+	void setLoadWarnings(bool enable);
+	quint64 framesCaptured() const;
+	quint64 framesDropped() const;
+	double motionEventsPerFrame() const;
+	double inputLatency() const;
     
   protected:
     void initializeGL();
     void resizeGL(int width, int height);
     void paintGL();
+	void glDraw();
     void mousePressEvent(QMouseEvent *event);
     void mouseMoveEvent(QMouseEvent *event);
+	void paintEvent(QPaintEvent *event);
+	void resizeEvent(QResizeEvent *event);
 	
+  private slots:
+	void renderScheduledFrame();
+	void cubeTextureLoaded();
+	void floorTextureLoaded();
+	void loadMissingTextures();
+	void loadDeferredTextures();
+
   public slots:
     void setXRotation(int angle);
     void setYRotation(int angle);
@@ -84,6 +260,7 @@ class GLWidget: public QGLWidget{
     void setCubeRedComponent(int value);
     void setCubeGreenComponent(int value);
     void setCubeBlueComponent(int value);
+	void setCubeColor(int red, int green, int blue);
 	void enableLighting();
 	void disableLighting();
 	void setLighting(bool activation);
@@ -93,6 +270,8 @@ class GLWidget: public QGLWidget{
 	void setDiffuseLightRedComponent(int value);
 	void setDiffuseLightGreenComponent(int value);
 	void setDiffuseLightBlueComponent(int value);	
+	void setAmbientLight(int red, int green, int blue);
+	void setDiffuseLight(int red, int green, int blue);
 	void enableCubeTexture(const QString &imageFileName);
 	void disableCubeTexture();
 	void enableFloorTexture(const QString &imageFileName);
@@ -102,12 +281,16 @@ class GLWidget: public QGLWidget{
 	void setFogRedComponent(int);
 	void setFogGreenComponent(int);
 	void setFogBlueComponent(int);
+	void setFogColor(int red, int green, int blue);
 	void setFogStart(int);
 	void setFogEnd(int);
+	void setProfiling(bool enable);
+	void setInstances(int count);
 
   signals:
 	void cubeTexturingFailed(); //!< Emmited if cube texturing process failed.
 	void floorTexturingFailed(); //!< Emmited if floor texuring process failed.
+	void instanceThroughputChanged(double instancesPerSecond); //!< Emmited every second while drawing the cube lattice.
 
 
 }; //END class GLWidget.
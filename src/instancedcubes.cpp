@@ -0,0 +1,289 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   instancedcubes.cpp
+ * @author Rafael Palomar
+ * @date   Mon May 31 12:51:40 2010
+ *
+ * @brief  InstancedCubes class definition.
+ *
+ * This file contains the definition of the InstancedCubes class.
+ *
+ */
+
+#include "instancedcubes.h"
+#include "programcache.h"
+#include "simdmath.h"
+
+#include <QGLShaderProgram>
+
+#include <cstddef>
+#include <cstring>
+
+//!Vertex shader: instance transform, then the fixed function matrices
+//!and light 1.
+static const char *vertexShaderSource =
+	"#version 120\n"
+	"attribute mat4 instanceTransform;\n"
+	"attribute vec4 instanceColor;\n"
+	"uniform bool lighting;\n"
+	"varying vec4 color;\n"
+	"varying float fogDepth;\n"
+	"void main(){\n"
+	"	vec4 position = gl_ModelViewMatrix * (instanceTransform * gl_Vertex);\n"
+	"	color = instanceColor;\n"
+	"	if(lighting){\n"
+	"		vec3 normal = normalize(gl_NormalMatrix * (mat3(instanceTransform) * gl_Normal));\n"
+	"		vec3 light = normalize(gl_LightSource[1].position.xyz - position.xyz);\n"
+	"		color.rgb *= gl_LightModel.ambient.rgb + gl_LightSource[1].ambient.rgb\n"
+	"			+ gl_LightSource[1].diffuse.rgb * max(dot(normal, light), 0.0);\n"
+	"	}\n"
+	"	fogDepth = abs(position.z);\n"
+	"	gl_Position = gl_ProjectionMatrix * position;\n"
+	"}\n";
+
+//!Fragment shader: linear fog as set up for the fixed function.
+static const char *fragmentShaderSource =
+	"#version 120\n"
+	"uniform bool fog;\n"
+	"varying vec4 color;\n"
+	"varying float fogDepth;\n"
+	"void main(){\n"
+	"	gl_FragColor = color;\n"
+	"	if(fog){\n"
+	"		float factor = clamp((gl_Fog.end - fogDepth) * gl_Fog.scale, 0.0, 1.0);\n"
+	"		gl_FragColor.rgb = mix(gl_Fog.color.rgb, color.rgb, factor);\n"
+	"	}\n"
+	"}\n";
+
+/**
+ * @brief Default constructor.
+ *
+ */
+InstancedCubes::InstancedCubes():instanceBuffer(QGLBuffer::VertexBuffer){
+
+	instanceCount = 0;
+	instancesDirty = false;
+	instancing = false;
+	drawArraysInstanced = 0;
+	vertexAttribDivisor = 0;
+	program = 0;
+	bufferedCount = 0;
+	//NVIDIA aliases generic attributes to the fixed arrays: 0 vertex,
+	//2 normal, 3 color, 4 secondary color, 5 fog coordinate, 8-15 texture
+	//coordinates. The lattice only sets vertex and normal arrays, so the
+	//instance attributes take 4-7 and 1, which no array in use aliases.
+	transformLocation = 4;
+	colorLocation = 1;
+}
+
+/**
+ * @brief Destructor.
+ *
+ * The context of the program must be current.
+ */
+InstancedCubes::~InstancedCubes(){
+
+	delete program;
+}
+
+/**
+ * @brief Initialize.
+ *
+ * Resolves the instancing entry points and builds the shader program.
+ * Must be called with the context current.
+ *
+ * @param context the GL context the cubes are drawn in.
+ * @param programCache the cache the program is built through.
+ */
+void InstancedCubes::initialize(const QGLContext *context, ProgramCache &programCache){
+
+	QByteArray extensions((const char *)glGetString(GL_EXTENSIONS));
+
+	drawArraysInstanced = (DrawArraysInstanced)context->getProcAddress("glDrawArraysInstanced");
+	if(!drawArraysInstanced)
+		drawArraysInstanced = (DrawArraysInstanced)context->getProcAddress("glDrawArraysInstancedARB");
+	vertexAttribDivisor = (VertexAttribDivisor)context->getProcAddress("glVertexAttribDivisor");
+	if(!vertexAttribDivisor)
+		vertexAttribDivisor = (VertexAttribDivisor)context->getProcAddress("glVertexAttribDivisorARB");
+
+	instancing = QGLShaderProgram::hasOpenGLShaderPrograms()
+		&& extensions.contains("GL_ARB_instanced_arrays")
+		&& drawArraysInstanced && vertexAttribDivisor;
+
+	delete program;
+	program = 0;
+
+	if(instancing){
+		program = new QGLShaderProgram;
+		program->bindAttributeLocation("instanceTransform", transformLocation);
+		program->bindAttributeLocation("instanceColor", colorLocation);
+
+		instancing = programCache.build(program, vertexShaderSource, fragmentShaderSource)
+			&& instanceBuffer.create();
+	}
+
+	if(instancing)
+		instanceBuffer.setUsagePattern(QGLBuffer::StaticDraw);
+	else{
+		delete program;
+		program = 0;
+	}
+
+	instancesDirty = true;
+}
+
+/**
+ * @brief Set count.
+ *
+ * The lattice is rebuilt on the next draw.
+ *
+ * @param count number of cubes, 0 disables the lattice.
+ */
+void InstancedCubes::setCount(int count){
+
+	if(count == instanceCount)
+		return;
+
+	instanceCount = count;
+	instancesDirty = true;
+}
+
+/**
+ * @brief Count.
+ *
+ * @return the number of cubes.
+ */
+int InstancedCubes::count() const{
+
+	return instanceCount;
+}
+
+/**
+ * @brief Instanced.
+ *
+ * @return true if the cubes are drawn with a single instanced call.
+ */
+bool InstancedCubes::isInstanced() const{
+
+	return instancing;
+}
+
+/**
+ * @brief Draw.
+ *
+ * Draws every cube. The caller sets the vertex and normal arrays of the
+ * cube geometry beforehand.
+ *
+ * @param lighting whether light 1 lights the cubes.
+ * @param fog whether the cubes are fogged.
+ */
+void InstancedCubes::draw(bool lighting, bool fog){
+
+	if(instancesDirty){
+		createInstances();
+		if(instancing){
+			instanceBuffer.bind();
+			instanceBuffer.allocate(instances.constData(), instances.size()*sizeof(Instance));
+			//Never draw more instances than the buffer could take.
+			bufferedCount = qMax(0, instanceBuffer.size())/sizeof(Instance);
+			instanceBuffer.release();
+			instances.clear();
+		}
+		instancesDirty = false;
+	}
+
+	if(!instancing){
+		for(int i = 0; i < instances.size(); i++){
+			glPushMatrix();
+			glMultMatrixf(instances[i].transform);
+			glColor4ubv(instances[i].color);
+			glDrawArrays(GL_QUADS, 0, 24);
+			glPopMatrix();
+		}
+		return;
+	}
+
+	program->bind();
+	program->setUniformValue("lighting", (int)lighting);
+	program->setUniformValue("fog", (int)fog);
+
+	instanceBuffer.bind();
+	for(int column = 0; column < 4; column++){
+		program->enableAttributeArray(transformLocation + column);
+		program->setAttributeBuffer(transformLocation + column, GL_FLOAT,
+									offsetof(Instance, transform) + column*4*sizeof(GLfloat),
+									4, sizeof(Instance));
+		vertexAttribDivisor(transformLocation + column, 1);
+	}
+	program->enableAttributeArray(colorLocation);
+	program->setAttributeBuffer(colorLocation, GL_UNSIGNED_BYTE,
+								offsetof(Instance, color), 4, sizeof(Instance));
+	vertexAttribDivisor(colorLocation, 1);
+	instanceBuffer.release();
+
+	drawArraysInstanced(GL_QUADS, 0, 24, qMin(instanceCount, bufferedCount));
+
+	for(int column = 0; column < 4; column++){
+		vertexAttribDivisor(transformLocation + column, 0);
+		program->disableAttributeArray(transformLocation + column);
+	}
+	vertexAttribDivisor(colorLocation, 0);
+	program->disableAttributeArray(colorLocation);
+
+	program->release();
+}
+
+/**
+ * @brief Create instances.
+ *
+ * Lays the cubes out on a lattice inside the [-1,1] cube, each one
+ * turned around its own axis and colored after its place.
+ *
+ */
+void InstancedCubes::createInstances(){
+
+	instances.resize(instanceCount);
+
+	int side = 1;
+	while(side*side*side < instanceCount)
+		side++;
+
+	for(int i = 0; i < instanceCount; i++){
+
+		int x = i % side;
+		int y = (i / side) % side;
+		int z = i / (side*side);
+
+		Mat4 transform = Mat4::translation((2*x + 1.0f)/side - 1.0f,
+										   (2*y + 1.0f)/side - 1.0f,
+										   (2*z + 1.0f)/side - 1.0f)
+			*Mat4::rotation((i*37) % 360, x + 1.0f, y + 1.0f, z + 1.0f)
+			*Mat4::scaling(0.6f/side);
+
+		Instance &instance = instances[i];
+		memcpy(instance.transform, transform.data(), sizeof(instance.transform));
+
+		instance.color[0] = 55 + 200*x/side;
+		instance.color[1] = 55 + 200*y/side;
+		instance.color[2] = 55 + 200*z/side;
+		instance.color[3] = 255;
+	}
+}
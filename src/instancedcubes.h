@@ -0,0 +1,94 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   instancedcubes.h
+ * @author Rafael Palomar
+ * @date   Mon May 31 12:26:09 2010
+ *
+ * @brief  InstancedCubes class header.
+ *
+ * This file contains the declaration of the class InstancedCubes.
+ *
+ */
+
+#ifndef INSTANCEDCUBES_H
+#define INSTANCEDCUBES_H
+
+#include <QVector>
+#include <QGLBuffer>
+#include <QtOpenGL>
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+class QGLShaderProgram;
+class ProgramCache;
+
+//!Class InstancedCubes.
+/*!
+ * Lattice of cubes drawn with the cube geometry for stress testing. Each
+ * cube has its own transform and color in an instance buffer, and all of
+ * them are drawn with a single glDrawArraysInstanced call. Without
+ * instanced arrays the cubes are drawn one by one.
+ *
+ * The lattice fills the space of the single cube, so it is drawn with the
+ * cube transform.
+ */
+class InstancedCubes{
+
+  private:
+	//!Per instance attributes.
+	struct Instance{
+		GLfloat transform[16];
+		GLubyte color[4];
+	};
+
+	typedef void (APIENTRY *DrawArraysInstanced)(GLenum mode, GLint first,
+												  GLsizei count, GLsizei instances);
+	typedef void (APIENTRY *VertexAttribDivisor)(GLuint index, GLuint divisor);
+
+	QVector<Instance> instances;
+	int instanceCount;
+	int bufferedCount;
+	bool instancesDirty;
+	bool instancing;
+	DrawArraysInstanced drawArraysInstanced;
+	VertexAttribDivisor vertexAttribDivisor;
+	QGLShaderProgram *program;
+	QGLBuffer instanceBuffer;
+	int transformLocation;
+	int colorLocation;
+
+	void createInstances();
+
+  public:
+	InstancedCubes();
+	~InstancedCubes();
+
+	void initialize(const QGLContext *context, ProgramCache &programCache);
+	void setCount(int count);
+	int count() const;
+	bool isInstanced() const;
+	void draw(bool lighting, bool fog);
+
+}; //END class InstancedCubes.
+
+#endif
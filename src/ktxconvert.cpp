@@ -0,0 +1,291 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   ktxconvert.cpp
+ * @author Rafael Palomar
+ * @date   Wed May 26 10:12:40 2010
+ *
+ * @brief  Offline texture converter.
+ *
+ * This file contains the entry point of basicgl_ktxconvert, which
+ * decodes an image, builds its mipmap chain, optionally compresses it
+ * with S3TC (DXT1) and writes it as a KTX file. GLWidget maps such files
+ * and uploads them without decoding, e.g.:
+ *
+ *   ./basicgl_ktxconvert --dxt1 resources/floor.png
+ *
+ * writes resources/floor.ktx, which is then used whenever floor.png is
+ * chosen as a texture.
+ *
+ */
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QImage>
+#include <QGLWidget>
+
+#include "ktxfile.h"
+
+/**
+ * @brief Pack RGB 565.
+ *
+ * @param color a pixel in GL RGBA byte order.
+ *
+ * @return the color as a 16 bit 565 value.
+ */
+static quint16 packRgb565(const uchar *color){
+
+	return ((color[0] >> 3) << 11) | ((color[1] >> 2) << 5) | (color[2] >> 3);
+}
+
+/**
+ * @brief Unpack RGB 565.
+ *
+ * @param value a 16 bit 565 color.
+ * @param color the 8 bit per channel color.
+ */
+static void unpackRgb565(quint16 value, int *color){
+
+	int red = (value >> 11) & 0x1f;
+	int green = (value >> 5) & 0x3f;
+	int blue = value & 0x1f;
+
+	color[0] = (red << 3) | (red >> 2);
+	color[1] = (green << 2) | (green >> 4);
+	color[2] = (blue << 3) | (blue >> 2);
+}
+
+/**
+ * @brief Encode a DXT1 block.
+ *
+ * The end points are the corners of the bounding box of the block
+ * colors, which is fast and good enough for the scene textures.
+ *
+ * @param pixels the 16 pixels of the block in GL RGBA byte order.
+ * @param block the 8 bytes of the compressed block.
+ */
+static void encodeDxt1Block(const uchar pixels[16][4], uchar *block){
+
+	uchar minColor[4] = {255, 255, 255, 255};
+	uchar maxColor[4] = {0, 0, 0, 255};
+
+	for(int i = 0; i < 16; i++)
+		for(int c = 0; c < 3; c++){
+			minColor[c] = qMin(minColor[c], pixels[i][c]);
+			maxColor[c] = qMax(maxColor[c], pixels[i][c]);
+		}
+
+	quint16 color0 = packRgb565(maxColor);
+	quint16 color1 = packRgb565(minColor);
+	quint32 indices = 0;
+
+	//color0 > color1 selects the four color mode.
+	if(color0 < color1)
+		qSwap(color0, color1);
+
+	if(color0 != color1){
+
+		int palette[4][3];
+		unpackRgb565(color0, palette[0]);
+		unpackRgb565(color1, palette[1]);
+		for(int c = 0; c < 3; c++){
+			palette[2][c] = (2*palette[0][c] + palette[1][c])/3;
+			palette[3][c] = (palette[0][c] + 2*palette[1][c])/3;
+		}
+
+		for(int i = 0; i < 16; i++){
+
+			int best = 0;
+			int bestDistance = 0x7fffffff;
+
+			for(int p = 0; p < 4; p++){
+				int distance = 0;
+				for(int c = 0; c < 3; c++){
+					int delta = pixels[i][c] - palette[p][c];
+					distance += delta*delta;
+				}
+				if(distance < bestDistance){
+					best = p;
+					bestDistance = distance;
+				}
+			}
+
+			indices |= (quint32)best << (2*i);
+		}
+	}
+
+	block[0] = color0 & 0xff;
+	block[1] = color0 >> 8;
+	block[2] = color1 & 0xff;
+	block[3] = color1 >> 8;
+	block[4] = indices & 0xff;
+	block[5] = (indices >> 8) & 0xff;
+	block[6] = (indices >> 16) & 0xff;
+	block[7] = indices >> 24;
+}
+
+/**
+ * @brief Compress a level with DXT1.
+ *
+ * Blocks on the right and top edges repeat the last column and row when
+ * the size is not a multiple of four.
+ *
+ * @param image a level in GL format.
+ *
+ * @return the compressed level.
+ */
+static QByteArray compressDxt1(const QImage &image){
+
+	int width = image.width();
+	int height = image.height();
+	int blocksWide = (width + 3)/4;
+	int blocksHigh = (height + 3)/4;
+
+	QByteArray data(blocksWide*blocksHigh*8, 0);
+	uchar *block = (uchar *)data.data();
+
+	for(int by = 0; by < blocksHigh; by++)
+		for(int bx = 0; bx < blocksWide; bx++){
+
+			uchar pixels[16][4];
+
+			for(int y = 0; y < 4; y++){
+				const uchar *row = image.scanLine(qMin(by*4 + y, height - 1));
+				for(int x = 0; x < 4; x++){
+					const uchar *pixel = row + 4*qMin(bx*4 + x, width - 1);
+					for(int c = 0; c < 4; c++)
+						pixels[y*4 + x][c] = pixel[c];
+				}
+			}
+
+			encodeDxt1Block(pixels, block);
+			block += 8;
+		}
+
+	return data;
+}
+
+/**
+ * @brief Usage.
+ *
+ * Prints the command line of the converter.
+ *
+ */
+static void usage(){
+
+	QTextStream err(stderr);
+	err << "Usage: basicgl_ktxconvert [--dxt1] [--no-mipmaps] IMAGE [OUTPUT]\n";
+}
+
+/**
+ * @brief Main
+ *
+ * Entry point of the converter.
+ *
+ * @param argc number of arguments.
+ * @param argv arguments array.
+ *
+ * @return 0 on success, 1 on bad arguments and 2 if the image could not
+ * be read or the KTX file written.
+ */
+int main(int argc, char *argv[]){
+
+	QCoreApplication app(argc, argv);
+
+	bool dxt1 = false;
+	bool mipmaps = true;
+	QString inputFileName;
+	QString outputFileName;
+
+	QStringList args = app.arguments();
+	for(int i = 1; i < args.size(); i++){
+
+		if(args[i] == "--dxt1")
+			dxt1 = true;
+		else if(args[i] == "--no-mipmaps")
+			mipmaps = false;
+		else if(inputFileName.isEmpty())
+			inputFileName = args[i];
+		else if(outputFileName.isEmpty())
+			outputFileName = args[i];
+		else{
+			usage();
+			return 1;
+		}
+	}
+
+	if(inputFileName.isEmpty()){
+		usage();
+		return 1;
+	}
+
+	if(outputFileName.isEmpty()){
+		QFileInfo input(inputFileName);
+		outputFileName = input.path() + "/" + input.completeBaseName() + ".ktx";
+	}
+
+	QImage image;
+	if(!image.load(inputFileName)){
+		QTextStream(stderr) << "basicgl_ktxconvert: cannot read " << inputFileName << "\n";
+		return 2;
+	}
+
+	//Every level is resampled from the source image.
+	QList<QByteArray> levels;
+	int width = image.width();
+	int height = image.height();
+
+	for(int i = 0; ; i++){
+
+		int levelWidth = qMax(1, width >> i);
+		int levelHeight = qMax(1, height >> i);
+
+		QImage level = image;
+		if(i > 0)
+			level = image.scaled(levelWidth, levelHeight, Qt::IgnoreAspectRatio,
+								 Qt::SmoothTransformation);
+		level = QGLWidget::convertToGLFormat(level);
+
+		if(dxt1)
+			levels.append(compressDxt1(level));
+		else
+			levels.append(QByteArray((const char *)level.bits(), level.byteCount()));
+
+		if(!mipmaps || (levelWidth == 1 && levelHeight == 1))
+			break;
+	}
+
+	bool written;
+	if(dxt1)
+		written = KtxFile::write(outputFileName, 0, 0, GL_COMPRESSED_RGB_S3TC_DXT1_EXT,
+								 GL_RGB, width, height, levels);
+	else
+		written = KtxFile::write(outputFileName, GL_UNSIGNED_BYTE, GL_RGBA, GL_RGB,
+								 GL_RGB, width, height, levels);
+
+	if(!written){
+		QTextStream(stderr) << "basicgl_ktxconvert: cannot write " << outputFileName << "\n";
+		return 2;
+	}
+
+	return 0;
+}
@@ -0,0 +1,351 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   ktxfile.cpp
+ * @author Rafael Palomar
+ * @date   Tue May 25 18:30:17 2010
+ *
+ * @brief  KtxFile class definition.
+ *
+ * This file contains the definition of the KtxFile class, which reads
+ * and writes the KTX 1.1 container (Khronos texture file).
+ *
+ */
+
+#include "ktxfile.h"
+
+#include <cstring>
+
+//!File identifier of KTX 1.1.
+static const uchar ktxIdentifier[12] = {
+	0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+
+static const quint32 ktxEndianness = 0x04030201;
+
+//!Largest width and height taken, so level sizes fit the int of the GL.
+static const quint32 maxSide = 1 << 14;
+
+//!KTX header, following the identifier.
+struct KtxHeader{
+	quint32 endianness;
+	quint32 glType;
+	quint32 glTypeSize;
+	quint32 glFormat;
+	quint32 glInternalFormat;
+	quint32 glBaseInternalFormat;
+	quint32 pixelWidth;
+	quint32 pixelHeight;
+	quint32 pixelDepth;
+	quint32 numberOfArrayElements;
+	quint32 numberOfFaces;
+	quint32 numberOfMipmapLevels;
+	quint32 bytesOfKeyValueData;
+};
+
+/**
+ * @brief Level size.
+ *
+ * @param header the header of the file.
+ * @param width width of the level.
+ * @param height height of the level.
+ *
+ * @return the number of bytes the GL reads for the level, with rows
+ * aligned to 4 bytes as KTX stores them, or -1 for formats that are not
+ * supported.
+ */
+static qint64 levelSize(const KtxHeader &header, qint64 width, qint64 height){
+
+	if(header.glType == 0)
+		return header.glInternalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+			? ((width + 3)/4)*((height + 3)/4)*8 : -1;
+
+	if(header.glType != GL_UNSIGNED_BYTE)
+		return -1;
+
+	int pixelBytes;
+	switch(header.glFormat){
+	case GL_RGBA:
+	case GL_BGRA:
+		pixelBytes = 4;
+		break;
+	case GL_RGB:
+	case GL_BGR:
+		pixelBytes = 3;
+		break;
+	case GL_LUMINANCE_ALPHA:
+		pixelBytes = 2;
+		break;
+	case GL_LUMINANCE:
+	case GL_ALPHA:
+		pixelBytes = 1;
+		break;
+	default:
+		return -1;
+	}
+
+	return ((width*pixelBytes + 3) & ~3)*height;
+}
+
+/**
+ * @brief Default constructor.
+ *
+ */
+KtxFile::KtxFile(){
+
+	mapped = 0;
+	type = 0;
+	format = 0;
+	internalFormat = 0;
+	pixelWidth = 0;
+	pixelHeight = 0;
+}
+
+/**
+ * @brief Destructor.
+ *
+ * Unmaps the file.
+ */
+KtxFile::~KtxFile(){
+
+	if(mapped)
+		file.unmap(mapped);
+}
+
+/**
+ * @brief Open a KTX file.
+ *
+ * Maps the file and checks that its header and mipmap levels are
+ * consistent with its size, and that every level holds all the bytes its
+ * size and format need, so the GL never reads past it.
+ *
+ * @param fileName the name of the KTX file.
+ *
+ * @return true if the file is a 2D texture that can be uploaded as is.
+ */
+bool KtxFile::open(const QString &fileName){
+
+	file.setFileName(fileName);
+	if(!file.open(QIODevice::ReadOnly))
+		return false;
+
+	qint64 fileSize = file.size();
+	if(fileSize < (qint64)(sizeof(ktxIdentifier) + sizeof(KtxHeader)))
+		return false;
+
+	mapped = file.map(0, fileSize);
+	if(!mapped)
+		return false;
+
+	if(memcmp(mapped, ktxIdentifier, sizeof(ktxIdentifier)))
+		return false;
+
+	KtxHeader header;
+	memcpy(&header, mapped + sizeof(ktxIdentifier), sizeof(header));
+
+	if(header.endianness != ktxEndianness
+	   || header.pixelWidth == 0 || header.pixelHeight == 0
+	   || header.pixelWidth > maxSide || header.pixelHeight > maxSide
+	   || header.pixelDepth != 0 || header.numberOfArrayElements != 0
+	   || header.numberOfFaces != 1)
+		return false;
+
+	//A full chain ends with a 1x1 level: floor(log2(max(w,h))) + 1 levels.
+	quint32 maxLevels = 1;
+	while((qMax(header.pixelWidth, header.pixelHeight) >> maxLevels) > 0)
+		maxLevels++;
+	if(header.numberOfMipmapLevels > maxLevels)
+		return false;
+
+	type = header.glType;
+	format = header.glFormat;
+	internalFormat = header.glInternalFormat;
+	pixelWidth = header.pixelWidth;
+	pixelHeight = header.pixelHeight;
+
+	qint64 offset = sizeof(ktxIdentifier) + sizeof(header)
+		+ (qint64)header.bytesOfKeyValueData;
+	int levelCount = qMax(1, (int)header.numberOfMipmapLevels);
+
+	for(int i = 0; i < levelCount; i++){
+
+		quint32 imageSize;
+		if(offset + (qint64)sizeof(imageSize) > fileSize)
+			return false;
+		memcpy(&imageSize, mapped + offset, sizeof(imageSize));
+		offset += sizeof(imageSize);
+
+		if(offset + (qint64)imageSize > fileSize)
+			return false;
+
+		qint64 expected = levelSize(header, qMax(1, pixelWidth >> i),
+									qMax(1, pixelHeight >> i));
+		if(expected < 0 || (qint64)imageSize < expected || imageSize > 0x7FFFFFFFu)
+			return false;
+
+		Level level;
+		level.width = qMax(1, pixelWidth >> i);
+		level.height = qMax(1, pixelHeight >> i);
+		level.size = imageSize;
+		level.data = mapped + offset;
+		mipmapLevels.append(level);
+
+		offset += (imageSize + 3) & ~3;
+	}
+
+	return true;
+}
+
+/**
+ * @brief GL type.
+ *
+ * @return the pixel type for glTexImage2D, 0 for compressed textures.
+ */
+GLenum KtxFile::glType() const{
+
+	return type;
+}
+
+/**
+ * @brief GL format.
+ *
+ * @return the pixel format for glTexImage2D, 0 for compressed textures.
+ */
+GLenum KtxFile::glFormat() const{
+
+	return format;
+}
+
+/**
+ * @brief GL internal format.
+ *
+ * @return the internal format of the texture.
+ */
+GLenum KtxFile::glInternalFormat() const{
+
+	return internalFormat;
+}
+
+/**
+ * @brief Compressed.
+ *
+ * @return true if the levels must be uploaded with glCompressedTexImage2D.
+ */
+bool KtxFile::isCompressed() const{
+
+	return type == 0;
+}
+
+/**
+ * @brief Width.
+ *
+ * @return the width of the first level.
+ */
+int KtxFile::width() const{
+
+	return pixelWidth;
+}
+
+/**
+ * @brief Height.
+ *
+ * @return the height of the first level.
+ */
+int KtxFile::height() const{
+
+	return pixelHeight;
+}
+
+/**
+ * @brief Levels.
+ *
+ * @return the mipmap levels, largest first.
+ */
+const QList<KtxFile::Level> &KtxFile::levels() const{
+
+	return mipmapLevels;
+}
+
+/**
+ * @brief Data size.
+ *
+ * @return the number of bytes of all the mipmap levels.
+ */
+qint64 KtxFile::dataSize() const{
+
+	qint64 size = 0;
+	for(int i = 0; i < mipmapLevels.size(); i++)
+		size += mipmapLevels[i].size;
+
+	return size;
+}
+
+/**
+ * @brief Write a KTX file.
+ *
+ * @param fileName the name of the file to write.
+ * @param glType the pixel type, 0 for compressed data.
+ * @param glFormat the pixel format, 0 for compressed data.
+ * @param glInternalFormat the internal format of the texture.
+ * @param glBaseInternalFormat the base internal format of the texture.
+ * @param width the width of the first level.
+ * @param height the height of the first level.
+ * @param levels the data of every mipmap level, largest first.
+ *
+ * @return true if the file was written.
+ */
+bool KtxFile::write(const QString &fileName, GLenum glType, GLenum glFormat,
+					GLenum glInternalFormat, GLenum glBaseInternalFormat,
+					int width, int height, const QList<QByteArray> &levels){
+
+	QFile output(fileName);
+	if(!output.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		return false;
+
+	KtxHeader header;
+	header.endianness = ktxEndianness;
+	header.glType = glType;
+	header.glTypeSize = 1;	//Byte data, and 1 for compressed data.
+	header.glFormat = glFormat;
+	header.glInternalFormat = glInternalFormat;
+	header.glBaseInternalFormat = glBaseInternalFormat;
+	header.pixelWidth = width;
+	header.pixelHeight = height;
+	header.pixelDepth = 0;
+	header.numberOfArrayElements = 0;
+	header.numberOfFaces = 1;
+	header.numberOfMipmapLevels = levels.size();
+	header.bytesOfKeyValueData = 0;
+
+	output.write((const char *)ktxIdentifier, sizeof(ktxIdentifier));
+	output.write((const char *)&header, sizeof(header));
+
+	static const char padding[3] = {0, 0, 0};
+
+	for(int i = 0; i < levels.size(); i++){
+
+		quint32 imageSize = levels[i].size();
+		output.write((const char *)&imageSize, sizeof(imageSize));
+		output.write(levels[i].constData(), imageSize);
+		output.write(padding, ((imageSize + 3) & ~3) - imageSize);
+	}
+
+	return output.flush() && output.error() == QFile::NoError;
+}
@@ -0,0 +1,103 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   ktxfile.h
+ * @author Rafael Palomar
+ * @date   Tue May 25 18:04:51 2010
+ *
+ * @brief  KtxFile class header.
+ *
+ * This file contains the declaration of the class KtxFile.
+ *
+ */
+
+#ifndef KTXFILE_H
+#define KTXFILE_H
+
+#include <QFile>
+#include <QList>
+#include <QByteArray>
+#include <QtOpenGL>
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+
+#ifndef GL_BGR
+#define GL_BGR 0x80E0
+#endif
+
+#ifndef GL_BGRA
+#define GL_BGRA 0x80E1
+#endif
+
+//!Class KtxFile.
+/*!
+ * Texture stored in the KTX container: pixel data already in a GL
+ * format (optionally block compressed) with its mipmap levels. Files
+ * are memory mapped, so levels can be handed to the GL without copies.
+ *
+ * Only 2D textures in the byte order of the machine are supported.
+ */
+class KtxFile{
+
+  public:
+	//!Mipmap level inside the mapped file.
+	struct Level{
+		int width;
+		int height;
+		int size;
+		const uchar *data;
+	};
+
+  private:
+	QFile file;
+	uchar *mapped;
+	GLenum type;
+	GLenum format;
+	GLenum internalFormat;
+	int pixelWidth;
+	int pixelHeight;
+	QList<Level> mipmapLevels;
+
+	Q_DISABLE_COPY(KtxFile);
+
+  public:
+	KtxFile();
+	~KtxFile();
+
+	bool open(const QString &fileName);
+
+	GLenum glType() const;
+	GLenum glFormat() const;
+	GLenum glInternalFormat() const;
+	bool isCompressed() const;
+	int width() const;
+	int height() const;
+	const QList<Level> &levels() const;
+	qint64 dataSize() const;
+
+	static bool write(const QString &fileName, GLenum glType, GLenum glFormat,
+					  GLenum glInternalFormat, GLenum glBaseInternalFormat,
+					  int width, int height, const QList<QByteArray> &levels);
+
+}; //END class KtxFile.
+
+#endif
@@ -161,7 +161,7 @@ QSlider *LightingWidget::createSlider(){
 void LightingWidget::ambientLightUpdateRed(int value){
 
 	ambientRedValueLabel->setNum(value);
-	emit ambientLightRedChanged(value);
+	emit ambientLightChanged(value, ambientGreenSlider->value(), ambientBlueSlider->value());
 }
 
 /** 
@@ -176,7 +176,7 @@ void LightingWidget::ambientLightUpdateRed(int value){
 void LightingWidget::ambientLightUpdateGreen(int value){
 
 	ambientGreenValueLabel->setNum(value);
-	emit ambientLightGreenChanged(value);
+	emit ambientLightChanged(ambientRedSlider->value(), value, ambientBlueSlider->value());
 }
 
 /** 
@@ -191,7 +191,7 @@ void LightingWidget::ambientLightUpdateGreen(int value){
 void LightingWidget::ambientLightUpdateBlue(int value){
 
 	ambientBlueValueLabel->setNum(value);
-	emit ambientLightBlueChanged(value);
+	emit ambientLightChanged(ambientRedSlider->value(), ambientGreenSlider->value(), value);
 }
 
 /** 
@@ -206,7 +206,7 @@ void LightingWidget::ambientLightUpdateBlue(int value){
 void LightingWidget::diffuseLightUpdateRed(int value){
 
 	diffuseRedValueLabel->setNum(value);
-	emit diffuseLightRedChanged(value);
+	emit diffuseLightChanged(value, diffuseGreenSlider->value(), diffuseBlueSlider->value());
 }
 
 /** 
@@ -221,7 +221,7 @@ void LightingWidget::diffuseLightUpdateRed(int value){
 void LightingWidget::diffuseLightUpdateGreen(int value){
 
 	diffuseGreenValueLabel->setNum(value);
-	emit diffuseLightGreenChanged(value);
+	emit diffuseLightChanged(diffuseRedSlider->value(), value, diffuseBlueSlider->value());
 }
 
 /** 
@@ -236,5 +236,5 @@ void LightingWidget::diffuseLightUpdateGreen(int value){
 void LightingWidget::diffuseLightUpdateBlue(int value){
 
 	diffuseBlueValueLabel->setNum(value);
-	emit diffuseLightBlueChanged(value);
+	emit diffuseLightChanged(diffuseRedSlider->value(), diffuseGreenSlider->value(), value);
 }
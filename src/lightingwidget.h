@@ -64,12 +64,8 @@ class LightingWidget: public QWidget{
 	
   signals:
 	void setLighting(bool enable); //!< Emmited on lighting activation switching.
-	void ambientLightRedChanged(int newValue); //!< Emmited when ambient red has changed.
-	void ambientLightGreenChanged(int newValue);//!< Emmited when ambient green has changed.
-	void ambientLightBlueChanged(int newValue);//!< Emmited when ambient blue has changed.
-	void diffuseLightRedChanged(int newValue);//!< Emmited when diffuse red has changed.
-	void diffuseLightGreenChanged(int newValue);//!< Emmited when diffuse green has changed.
-	void diffuseLightBlueChanged(int newValue);//!< Emmited when diffuse blue has changed.
+	void ambientLightChanged(int red, int green, int blue); //!< Emmited when any ambient component has changed.
+	void diffuseLightChanged(int red, int green, int blue); //!< Emmited when any diffuse component has changed.
 								  
   private slots:
 	void ambientLightUpdateRed(int newValue);
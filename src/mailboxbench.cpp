@@ -0,0 +1,230 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   mailboxbench.cpp
+ * @author Rafael Palomar
+ * @date   Wed Jun  9 15:37:20 2010
+ *
+ * @brief  Scene state mailbox stress benchmark.
+ *
+ * This file contains the entry point of basicgl_mailboxbench, which
+ * hammers the triple buffer that carries the scene states to the render
+ * thread. A producer thread publishes numbered states as fast as it can
+ * while the main thread takes them, and the results are written as JSON,
+ * e.g.:
+ *
+ *   ./basicgl_mailboxbench --versions 1000000
+ *
+ * Every field of a state holds its number, so a state read while being
+ * written shows up as torn. The numbers taken must never go back, and
+ * the last one published must be taken at the end. The exit code is 3 if
+ * any of these checks fails.
+ *
+ */
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QTextStream>
+#include <QThread>
+#include <QElapsedTimer>
+
+#include "scenestate.h"
+#include "triplebuffer.h"
+
+//!Class StateProducer.
+/*!
+ * Thread that publishes numbered scene states.
+ */
+class StateProducer: public QThread{
+
+  private:
+	TripleBuffer<SceneState> *mailbox;
+	int versions;
+	qint64 elapsed;
+
+  protected:
+	/**
+	 * @brief Run.
+	 *
+	 * Publishes the states 1 to versions.
+	 */
+	void run(){
+
+		QElapsedTimer timer;
+		timer.start();
+
+		for(int version = 1; version <= versions; version++){
+
+			SceneState &state = mailbox->writeBuffer();
+
+			for(int i = 0; i < 4; i++){
+				state.orientation.q[i] = (float)version;
+				state.ambientLight[i] = (float)version;
+				state.diffuseLight[i] = (float)version;
+				state.fogColor[i] = (float)version;
+			}
+			for(int i = 0; i < 3; i++)
+				state.cubeColor[i] = version;
+			state.fogStart = (float)version;
+			state.fogEnd = (float)version;
+			state.instances = version;
+			state.cubeTextureKey = QString::number(version);
+
+			mailbox->publish();
+		}
+
+		elapsed = timer.nsecsElapsed();
+	}
+
+  public:
+	/**
+	 * @brief Constructor.
+	 *
+	 * @param mailbox the mailbox to publish to.
+	 * @param versions number of states to publish.
+	 */
+	StateProducer(TripleBuffer<SceneState> *mailbox, int versions):
+		mailbox(mailbox), versions(versions), elapsed(0){}
+
+	/**
+	 * @brief Elapsed.
+	 *
+	 * @return the time spent publishing, in nanoseconds.
+	 */
+	qint64 nsecsElapsed() const{
+
+		return elapsed;
+	}
+
+}; //END class StateProducer.
+
+/**
+ * @brief Torn.
+ *
+ * @param state a scene state taken from the mailbox.
+ *
+ * @return true if the fields of the state do not all hold its number.
+ */
+static bool torn(const SceneState &state){
+
+	float version = (float)state.instances;
+
+	for(int i = 0; i < 4; i++){
+		if(state.orientation.q[i] != version || state.ambientLight[i] != version
+		   || state.diffuseLight[i] != version || state.fogColor[i] != version)
+			return true;
+	}
+	for(int i = 0; i < 3; i++){
+		if(state.cubeColor[i] != state.instances)
+			return true;
+	}
+
+	return state.fogStart != version || state.fogEnd != version
+		|| state.cubeTextureKey != QString::number(state.instances);
+}
+
+/**
+ * @brief Print usage.
+ *
+ */
+static void usage(){
+
+	QTextStream err(stderr);
+	err << "Usage: basicgl_mailboxbench [--versions N]\n";
+}
+
+/**
+ * @brief Main
+ *
+ * Entry point of the stress benchmark.
+ *
+ * @param argc number of arguments.
+ * @param argv arguments array.
+ *
+ * @return 0 on success, 1 on bad arguments and 3 if a check failed.
+ */
+int main(int argc, char *argv[]){
+
+	QCoreApplication app(argc, argv);
+
+	//The numbers are stored in floats too, which are exact up to 2^24.
+	int versions = 1000000;
+
+	QStringList args = app.arguments();
+	for(int i = 1; i < args.size(); i++){
+
+		bool ok = true;
+
+		if(args[i] == "--versions" && i + 1 < args.size())
+			versions = args[++i].toInt(&ok);
+		else
+			ok = false;
+
+		if(!ok || versions <= 0 || versions > (1 << 24)){
+			usage();
+			return 1;
+		}
+	}
+
+	TripleBuffer<SceneState> mailbox;
+	StateProducer producer(&mailbox, versions);
+
+	quint64 taken = 0;
+	quint64 tornStates = 0;
+	quint64 regressions = 0;
+	int last = 0;
+
+	producer.start();
+
+	//Taken until the producer is done, then once more for the last one.
+	bool running = true;
+	while(running){
+
+		running = producer.isRunning();
+
+		if(!mailbox.take())
+			continue;
+
+		const SceneState &state = mailbox.readBuffer();
+		taken++;
+
+		if(torn(state))
+			tornStates++;
+		else if(state.instances <= last)
+			regressions++;
+		else
+			last = state.instances;
+	}
+
+	producer.wait();
+	bool complete = last == versions;
+
+	QTextStream out(stdout);
+	out << "{\n";
+	out << "  \"versions\": " << versions << ",\n";
+	out << "  \"taken\": " << taken << ",\n";
+	out << "  \"publish_ns\": " << (double)producer.nsecsElapsed()/versions << ",\n";
+	out << "  \"torn\": " << tornStates << ",\n";
+	out << "  \"regressions\": " << regressions << ",\n";
+	out << "  \"last_taken\": " << last << "\n";
+	out << "}\n";
+
+	return tornStates || regressions || !complete ? 3 : 0;
+}
@@ -31,8 +31,11 @@
 
 #include <QApplication>
 #include <QDesktopWidget>
+#include <QStringList>
+#include <QTextStream>
 
 #include "mainwindow.h"
+#include "batchrender.h"
 
 
 /** 
@@ -41,6 +44,14 @@
  * This functions acts as entry point of the program. Its purpose
  * is to initialize, show and end the program.
  *
+ * --instances N starts with a lattice of N cubes instead of the cube.
+ * --record FILE records the view into FILE, as Y4M if it is named *.y4m
+ * and as raw RGBA otherwise.
+ * --batch DIR renders a parameter sweep into PNG files without opening
+ * the main window (see RenderSweep::parse()). Other arguments are ignored,
+ * as Qt may leave its own options in them.
+ * BASICGL_RENDER_THREAD=1 renders the scene in its own thread.
+ *
  * @param argc number of arguments.
  * @param argv arguments array.
  * 
@@ -48,11 +59,68 @@
  */
 int main(int argc, char *argv[]){
 
+	//Xlib has to be made thread safe before the application connects to
+	//the display, so the render thread can swap the buffers.
+	if(!qgetenv("BASICGL_RENDER_THREAD").isEmpty())
+		QCoreApplication::setAttribute(Qt::AA_X11InitThreads);
+
 	QApplication app(argc, argv);
 
+	int instances = 0;
+	QString recordFileName;
+
+	QStringList args = app.arguments();
+
+	if(args.contains("--batch")){
+
+		RenderSweep sweep;
+		QString error;
+
+		if(!sweep.parse(args, error)){
+			QTextStream(stderr) << "basicGL: bad argument " << error << "\n"
+								<< "Usage: basicGL --batch DIR [--size WxH] [--threads N]"
+								<< " [--lighting] [--reflection] [--rotation X,Y,Z]..."
+								<< " [--color R,G,B]... [--ambient R,G,B]..."
+								<< " [--diffuse R,G,B]... [--fog R,G,B,START,END|none]..."
+								<< " [--cube-texture FILE|none]..."
+								<< " [--floor-texture FILE|none]...\n";
+			return 1;
+		}
+
+		return renderSweep(sweep);
+	}
+
+	//Unknown arguments are skipped: they may be Qt options left in args.
+	for(int i = 1; i < args.size(); i++){
+
+		bool ok = true;
+
+		if(args[i] == "--instances"){
+			ok = i + 1 < args.size();
+			if(ok)
+				instances = args[++i].toInt(&ok);
+		}
+		else if(args[i] == "--record"){
+			ok = i + 1 < args.size();
+			if(ok)
+				recordFileName = args[++i];
+		}
+
+		if(!ok || instances < 0){
+			QTextStream(stderr) << "Usage: basicGL [--instances N] [--record FILE]\n";
+			return 1;
+		}
+	}
+
 	//Create main window
 	MainWindow mainWindow;
 	mainWindow.resize(853,480);
+	mainWindow.setInstances(instances);
+
+	if(!recordFileName.isEmpty() && !mainWindow.startRecording(recordFileName)){
+		QTextStream(stderr) << "basicGL: cannot write " << recordFileName << "\n";
+		return 1;
+	}
 
 	int desktopArea = QApplication::desktop()->width()* 
 		QApplication::desktop()->height();
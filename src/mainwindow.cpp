@@ -49,3 +49,29 @@ MainWindow::MainWindow(){
 	setWindowTitle("Basic GL");
 	
 }
+
+/** 
+ * @brief Set instances.
+ * 
+ * Sets the number of cubes of the stress lattice.
+ *
+ * @param count number of cubes, 0 for the single cube.
+ */
+void MainWindow::setInstances(int count){
+
+	centralWidget->setInstances(count);
+}
+
+/** 
+ * @brief Start recording.
+ * 
+ * Records the view into a video file.
+ *
+ * @param fileName the file to record to.
+ *
+ * @return false if the file cannot be created.
+ */
+bool MainWindow::startRecording(const QString &fileName){
+
+	return centralWidget->startRecording(fileName);
+}
@@ -34,6 +34,7 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include <QString>
 
 //Forward class declaration
 class CentralWidget;
@@ -46,6 +47,8 @@ class MainWindow: public QMainWindow
 	
   public:
 	MainWindow();
+	void setInstances(int count);
+	bool startRecording(const QString &fileName);
 
 }; //END class MainWindow.
 
@@ -0,0 +1,297 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   mathbench.cpp
+ * @author Rafael Palomar
+ * @date   Fri Jun  4 12:26:45 2010
+ *
+ * @brief  Math microbenchmark.
+ *
+ * This file contains the entry point of basicgl_mathbench, which times
+ * the matrix and quaternion products of simdmath.h against their scalar
+ * versions and writes the results as JSON, e.g.:
+ *
+ *   ./basicgl_mathbench --iterations 10000000
+ *
+ * Each product is chained onto its previous result, so the timings are
+ * of dependent operations, as when transforms are composed. The largest
+ * difference between both versions on the same inputs is reported along,
+ * and the exit code is 3 if it is larger than rounding can explain.
+ *
+ */
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QTextStream>
+#include <QElapsedTimer>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "simdmath.h"
+
+//!Number of operands the products cycle through (a power of two).
+static const int operandCount = 64;
+
+//!Largest difference from the scalar products put down to rounding.
+static const double maxRoundingDifference = 1.0e-5;
+
+//!Product of an operand and an accumulator, written to the accumulator.
+typedef void (*Product)(const float *operand, const float *accumulator, float *result);
+
+//!Last result of the timed products, which keeps them from being optimized
+//!away.
+volatile float productSink;
+
+//!Timings of a product.
+struct ProductResult{
+	const char *name;
+	double simdNs;
+	double scalarNs;
+	double maxDifference;
+};
+
+/**
+ * @brief Random number.
+ *
+ * @return a random number in [-1,1].
+ */
+static float randomUnit(){
+
+	return 2.0f*qrand()/RAND_MAX - 1.0f;
+}
+
+/**
+ * @brief Random rotation.
+ *
+ * @return a rotation around a random axis.
+ */
+static Quat randomRotation(){
+
+	return Quat::fromAxisAngle(180.0f*randomUnit(), randomUnit(), randomUnit(), 1.0f);
+}
+
+/**
+ * @brief Time a product.
+ *
+ * @param product the product.
+ * @param operands the operands, stride floats apart.
+ * @param stride number of floats of an operand.
+ * @param accumulator the initial accumulator.
+ * @param size number of floats of the accumulator.
+ * @param iterations number of products.
+ *
+ * @return the time of a product, in nanoseconds.
+ */
+static double timeProduct(Product product, const float *operands, int stride,
+						  const float *accumulator, int size, int iterations){
+
+	float value[16];
+	memcpy(value, accumulator, size*sizeof(float));
+
+	QElapsedTimer timer;
+	timer.start();
+
+	for(int i = 0; i < iterations; i++)
+		product(operands + (i & (operandCount - 1))*stride, value, value);
+
+	qint64 elapsed = timer.nsecsElapsed();
+
+	productSink = value[0];
+
+	return (double)elapsed/iterations;
+}
+
+/**
+ * @brief Largest difference.
+ *
+ * @param simd the SIMD product.
+ * @param scalar the scalar product.
+ * @param operands the operands, stride floats apart.
+ * @param stride number of floats of an operand.
+ * @param accumulators the accumulators, size floats apart.
+ * @param size number of floats of an accumulator.
+ *
+ * @return the largest absolute difference between both products of
+ * every operand and accumulator.
+ */
+static double maxDifference(Product simd, Product scalar, const float *operands, int stride,
+							const float *accumulators, int size){
+
+	double difference = 0.0;
+
+	for(int i = 0; i < operandCount; i++){
+		for(int j = 0; j < operandCount; j++){
+
+			float simdResult[16];
+			float scalarResult[16];
+			simd(operands + i*stride, accumulators + j*size, simdResult);
+			scalar(operands + i*stride, accumulators + j*size, scalarResult);
+
+			for(int k = 0; k < size; k++)
+				difference = qMax(difference, (double)fabs(simdResult[k] - scalarResult[k]));
+		}
+	}
+
+	return difference;
+}
+
+/**
+ * @brief Run a product.
+ *
+ * @param name name of the product.
+ * @param simd the SIMD product.
+ * @param scalar the scalar product.
+ * @param operands the operands, stride floats apart.
+ * @param stride number of floats of an operand.
+ * @param accumulators the accumulators, size floats apart.
+ * @param size number of floats of an accumulator.
+ * @param iterations number of products to time.
+ *
+ * @return the timings of both versions.
+ */
+static ProductResult runProduct(const char *name, Product simd, Product scalar,
+								const float *operands, int stride,
+								const float *accumulators, int size, int iterations){
+
+	ProductResult result;
+	result.name = name;
+
+	//Warm up the caches with the operands first.
+	timeProduct(simd, operands, stride, accumulators, size, operandCount);
+	result.simdNs = timeProduct(simd, operands, stride, accumulators, size, iterations);
+	result.scalarNs = timeProduct(scalar, operands, stride, accumulators, size, iterations);
+	result.maxDifference = maxDifference(simd, scalar, operands, stride, accumulators, size);
+
+	return result;
+}
+
+/**
+ * @brief Write results.
+ *
+ * @param out the stream to write to.
+ * @param iterations number of products timed.
+ * @param results the timings of every product.
+ * @param count number of products.
+ */
+static void writeResults(QTextStream &out, int iterations,
+						 const ProductResult *results, int count){
+
+	out << "{\n";
+	out << "  \"simd\": \"" << (simdEnabled() ? "sse" : "none") << "\",\n";
+	out << "  \"iterations\": " << iterations << ",\n";
+	out << "  \"products\": [\n";
+
+	for(int i = 0; i < count; i++){
+
+		const ProductResult &result = results[i];
+
+		out << "    {\"name\": \"" << result.name << "\"";
+		out << ", \"simd_ns\": " << result.simdNs;
+		out << ", \"scalar_ns\": " << result.scalarNs;
+		out << ", \"speedup\": " << result.scalarNs / result.simdNs;
+		out << ", \"max_abs_difference\": " << result.maxDifference;
+		out << "}" << (i + 1 < count ? ",\n" : "\n");
+	}
+
+	out << "  ]\n";
+	out << "}\n";
+}
+
+/**
+ * @brief Print usage.
+ *
+ */
+static void usage(){
+
+	QTextStream err(stderr);
+	err << "Usage: basicgl_mathbench [--iterations N]\n";
+}
+
+/**
+ * @brief Main
+ *
+ * Entry point of the microbenchmark.
+ *
+ * @param argc number of arguments.
+ * @param argv arguments array.
+ *
+ * @return 0 on success, 1 on bad arguments and 3 if a SIMD product
+ * differs from its scalar version.
+ */
+int main(int argc, char *argv[]){
+
+	QCoreApplication app(argc, argv);
+
+	int iterations = 10000000;
+
+	QStringList args = app.arguments();
+	for(int i = 1; i < args.size(); i++){
+
+		bool ok = true;
+
+		if(args[i] == "--iterations" && i + 1 < args.size())
+			iterations = args[++i].toInt(&ok);
+		else
+			ok = false;
+
+		if(!ok || iterations <= 0){
+			usage();
+			return 1;
+		}
+	}
+
+	qsrand(1);
+
+	//Rotations keep the chained products bounded.
+	float matrices[operandCount*16];
+	float vectors[operandCount*4];
+	float quaternions[operandCount*4];
+
+	for(int i = 0; i < operandCount; i++){
+
+		Quat rotation = randomRotation();
+		Mat4 matrix = rotation.toMatrix();
+
+		memcpy(matrices + i*16, matrix.data(), sizeof(matrix.m));
+		memcpy(quaternions + i*4, rotation.q, sizeof(rotation.q));
+
+		Vec4 vector(randomUnit(), randomUnit(), randomUnit());
+		memcpy(vectors + i*4, vector.v, sizeof(vector.v));
+	}
+
+	ProductResult results[3];
+	results[0] = runProduct("mat4_multiply", Mat4::multiply, Mat4::multiplyScalar,
+							matrices, 16, matrices, 16, iterations);
+	results[1] = runProduct("mat4_transform", Mat4::transform, Mat4::transformScalar,
+							matrices, 16, vectors, 4, iterations);
+	results[2] = runProduct("quat_multiply", Quat::multiply, Quat::multiplyScalar,
+							quaternions, 4, quaternions, 4, iterations);
+
+	QTextStream out(stdout);
+	writeResults(out, iterations, results, 3);
+
+	for(int i = 0; i < 3; i++)
+		if(!(results[i].maxDifference <= maxRoundingDifference))
+			return 3;
+
+	return 0;
+}
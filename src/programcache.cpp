@@ -0,0 +1,297 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   programcache.cpp
+ * @author Rafael Palomar
+ * @date   Thu Jun  3 10:32:51 2010
+ *
+ * @brief  ProgramCache class definition.
+ *
+ * This file contains the definition of the ProgramCache class.
+ *
+ */
+
+#include "programcache.h"
+
+#include <QCryptographicHash>
+#include <QDesktopServices>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QGLShaderProgram>
+
+#include <cstring>
+
+#ifndef GL_LINK_STATUS
+#define GL_LINK_STATUS 0x8B82
+#endif
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+//!Start of every cached binary, followed by the binary format.
+static const char magic[4] = {'B', 'G', 'L', 'P'};
+static const int headerSize = sizeof(magic) + sizeof(quint32);
+
+/**
+ * @brief Default constructor.
+ *
+ */
+ProgramCache::ProgramCache(){
+
+	binaries = false;
+	getProgramBinary = 0;
+	programBinary = 0;
+	programParameteri = 0;
+	hitCount = 0;
+	missCount = 0;
+	buildNsecs = 0;
+}
+
+/**
+ * @brief Initialize.
+ *
+ * Resolves the program binary entry points and works out the cache
+ * directory. Must be called with the context current.
+ *
+ * @param context the GL context the programs are built in.
+ */
+void ProgramCache::initialize(const QGLContext *context){
+
+	QByteArray extensions((const char *)glGetString(GL_EXTENSIONS));
+
+	getProgramBinary = (GetProgramBinary)context->getProcAddress("glGetProgramBinary");
+	programBinary = (ProgramBinary)context->getProcAddress("glProgramBinary");
+	programParameteri = (ProgramParameteri)context->getProcAddress("glProgramParameteri");
+
+	binaries = extensions.contains("GL_ARB_get_program_binary")
+		&& getProgramBinary && programBinary && programParameteri;
+
+	if(binaries){
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		binaries = formats > 0;
+	}
+
+	glFunctions.initializeGLFunctions(context);
+
+	driver = QByteArray((const char *)glGetString(GL_VENDOR)) + '\n'
+		+ (const char *)glGetString(GL_RENDERER) + '\n'
+		+ (const char *)glGetString(GL_VERSION);
+
+	directory = QFile::decodeName(qgetenv("BASICGL_PROGRAM_CACHE"));
+	if(directory.isEmpty())
+		directory = QDesktopServices::storageLocation(QDesktopServices::CacheLocation)
+			+ "/programs";
+}
+
+/**
+ * @brief Build a program.
+ *
+ * Loads the program from its cached binary or, failing that, compiles and
+ * links the sources and stores the binary for the next run. Attribute
+ * locations must be bound beforehand.
+ *
+ * @param program the program, without shaders.
+ * @param vertexSource the vertex shader source.
+ * @param fragmentSource the fragment shader source.
+ *
+ * @return true if the program is linked.
+ */
+bool ProgramCache::build(QGLShaderProgram *program,
+						 const QByteArray &vertexSource, const QByteArray &fragmentSource){
+
+	QElapsedTimer timer;
+	timer.start();
+
+	QString file;
+	bool linked = false;
+
+	if(binaries){
+		file = fileName(vertexSource, fragmentSource);
+		linked = load(program, file);
+	}
+
+	if(linked)
+		hitCount++;
+	else{
+		missCount++;
+
+		if(binaries)
+			programParameteri(program->programId(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+		linked = program->addShaderFromSourceCode(QGLShader::Vertex, vertexSource)
+			&& program->addShaderFromSourceCode(QGLShader::Fragment, fragmentSource)
+			&& program->link();
+
+		if(linked && binaries)
+			store(program, file);
+	}
+
+	buildNsecs += timer.nsecsElapsed();
+
+	return linked;
+}
+
+/**
+ * @brief Hits.
+ *
+ * @return the number of programs loaded from their binaries.
+ */
+quint64 ProgramCache::hits() const{
+
+	return hitCount;
+}
+
+/**
+ * @brief Misses.
+ *
+ * @return the number of programs compiled from source.
+ */
+quint64 ProgramCache::misses() const{
+
+	return missCount;
+}
+
+/**
+ * @brief Build time.
+ *
+ * @return the time spent building programs, in nanoseconds.
+ */
+qint64 ProgramCache::buildTime() const{
+
+	return buildNsecs;
+}
+
+/**
+ * @brief File name.
+ *
+ * @param vertexSource the vertex shader source.
+ * @param fragmentSource the fragment shader source.
+ *
+ * @return the path of the cached binary of the program.
+ */
+QString ProgramCache::fileName(const QByteArray &vertexSource,
+							   const QByteArray &fragmentSource) const{
+
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+	hash.addData(driver);
+	hash.addData("\0", 1);
+	hash.addData(vertexSource);
+	hash.addData("\0", 1);
+	hash.addData(fragmentSource);
+
+	return directory + "/" + hash.result().toHex() + ".bin";
+}
+
+/**
+ * @brief Load a binary.
+ *
+ * @param program the program, without shaders.
+ * @param file the cached binary.
+ *
+ * @return true if the GL accepted the binary. A binary it rejects is
+ * deleted.
+ */
+bool ProgramCache::load(QGLShaderProgram *program, const QString &file){
+
+	QFile in(file);
+	if(!in.open(QIODevice::ReadOnly))
+		return false;
+
+	QByteArray data = in.readAll();
+	in.close();
+
+	GLint linked = 0;
+
+	if(data.size() > headerSize && !memcmp(data.constData(), magic, sizeof(magic))){
+
+		quint32 format;
+		memcpy(&format, data.constData() + sizeof(magic), sizeof(format));
+
+		programBinary(program->programId(), format,
+					  data.constData() + headerSize, data.size() - headerSize);
+		glFunctions.glGetProgramiv(program->programId(), GL_LINK_STATUS, &linked);
+	}
+
+	if(!linked){
+		QFile::remove(file);
+		return false;
+	}
+
+	//Without shaders, link() only takes the state of the loaded binary.
+	return program->link();
+}
+
+/**
+ * @brief Store a binary.
+ *
+ * @param program the linked program.
+ * @param file the cached binary.
+ */
+void ProgramCache::store(QGLShaderProgram *program, const QString &file){
+
+	GLint length = 0;
+	glFunctions.glGetProgramiv(program->programId(), GL_PROGRAM_BINARY_LENGTH, &length);
+	if(length <= 0)
+		return;
+
+	QByteArray data(headerSize + length, 0);
+	GLsizei written = 0;
+	GLenum format = 0;
+	getProgramBinary(program->programId(), length, &written, &format, data.data() + headerSize);
+	if(written <= 0)
+		return;
+
+	quint32 storedFormat = format;
+	memcpy(data.data(), magic, sizeof(magic));
+	memcpy(data.data() + sizeof(magic), &storedFormat, sizeof(storedFormat));
+	data.resize(headerSize + written);
+
+	if(!QDir().mkpath(directory))
+		return;
+
+	//Written aside and renamed, so an interrupted run never leaves a
+	//truncated binary behind.
+	QString temporary = file + ".tmp";
+	QFile out(temporary);
+	if(!out.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		return;
+
+	bool saved = out.write(data) == data.size();
+	out.close();
+
+	if(saved){
+		QFile::remove(file);
+		saved = QFile::rename(temporary, file);
+	}
+
+	if(!saved)
+		QFile::remove(temporary);
+}
@@ -0,0 +1,94 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   programcache.h
+ * @author Rafael Palomar
+ * @date   Thu Jun  3 09:48:26 2010
+ *
+ * @brief  ProgramCache class header.
+ *
+ * This file contains the declaration of the class ProgramCache.
+ *
+ */
+
+#ifndef PROGRAMCACHE_H
+#define PROGRAMCACHE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QGLFunctions>
+#include <QtOpenGL>
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+class QGLShaderProgram;
+
+//!Class ProgramCache.
+/*!
+ * Keeps the binaries of the linked shader programs on disk, so later runs
+ * load them with glProgramBinary instead of compiling the sources. Files
+ * are named after a hash of the GL vendor, renderer and version strings
+ * and of the sources, so a driver update or a source change simply misses
+ * the cache. A binary the GL rejects is deleted and the program is built
+ * from source.
+ *
+ * The cache lives in the user cache directory, or in the directory given
+ * by BASICGL_PROGRAM_CACHE.
+ */
+class ProgramCache{
+
+  private:
+	typedef void (APIENTRY *GetProgramBinary)(GLuint program, GLsizei bufSize, GLsizei *length,
+											  GLenum *binaryFormat, void *binary);
+	typedef void (APIENTRY *ProgramBinary)(GLuint program, GLenum binaryFormat,
+										   const void *binary, GLsizei length);
+	typedef void (APIENTRY *ProgramParameteri)(GLuint program, GLenum name, GLint value);
+
+	bool binaries;
+	GetProgramBinary getProgramBinary;
+	ProgramBinary programBinary;
+	ProgramParameteri programParameteri;
+	QGLFunctions glFunctions;
+	QString directory;
+	QByteArray driver;
+	quint64 hitCount;
+	quint64 missCount;
+	qint64 buildNsecs;
+
+	QString fileName(const QByteArray &vertexSource, const QByteArray &fragmentSource) const;
+	bool load(QGLShaderProgram *program, const QString &file);
+	void store(QGLShaderProgram *program, const QString &file);
+
+  public:
+	ProgramCache();
+
+	void initialize(const QGLContext *context);
+	bool build(QGLShaderProgram *program,
+			   const QByteArray &vertexSource, const QByteArray &fragmentSource);
+
+	quint64 hits() const;
+	quint64 misses() const;
+	qint64 buildTime() const;
+
+}; //END class ProgramCache.
+
+#endif
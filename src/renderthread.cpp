@@ -0,0 +1,170 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   renderthread.cpp
+ * @author Rafael Palomar
+ * @date   Mon Jun  7 11:40:52 2010
+ *
+ * @brief  RenderThread class definition.
+ *
+ * This file contains the definition of the RenderThread class.
+ *
+ */
+
+#include "renderthread.h"
+#include "glwidget.h"
+
+#include <QMutexLocker>
+
+/**
+ * @brief Constructor.
+ *
+ * @param widget the widget whose frames are rendered.
+ */
+RenderThread::RenderThread(GLWidget *widget):widget(widget){
+
+	pendingWidth = 0;
+	pendingHeight = 0;
+	resizePending = false;
+	framePending = false;
+	stopping = false;
+}
+
+/**
+ * @brief Post a scene state.
+ *
+ * Replaces any state not rendered yet, so changes made between two
+ * frames are coalesced into the next one. Only to be called from the
+ * GUI thread.
+ *
+ * @param state the new scene state.
+ */
+void RenderThread::post(const SceneState &state){
+
+	states.writeBuffer() = state;
+	states.publish();
+
+	requestFrame();
+}
+
+/**
+ * @brief Take the scene state.
+ *
+ * Called by the renderer at the start of a frame.
+ *
+ * @return true if a state was posted since the last call; state() is
+ * then the latest one.
+ */
+bool RenderThread::take(){
+
+	return states.take();
+}
+
+/**
+ * @brief Scene state.
+ *
+ * @return the scene state taken by the last call to take().
+ */
+const SceneState &RenderThread::state() const{
+
+	return states.readBuffer();
+}
+
+/**
+ * @brief Resize.
+ *
+ * @param width the new width of the widget.
+ * @param height the new height of the widget.
+ */
+void RenderThread::resize(int width, int height){
+
+	QMutexLocker locker(&mutex);
+	pendingWidth = width;
+	pendingHeight = height;
+	resizePending = true;
+	wakeUp.wakeOne();
+}
+
+/**
+ * @brief Request a frame.
+ *
+ * Renders one more frame even if nothing changed, e.g. after the window
+ * was exposed or while the cube lattice is animated.
+ */
+void RenderThread::requestFrame(){
+
+	QMutexLocker locker(&mutex);
+	framePending = true;
+	wakeUp.wakeOne();
+}
+
+/**
+ * @brief Stop.
+ *
+ * Finishes the frame being rendered and waits for the thread to end. The
+ * context is released, so the caller can make it current again.
+ */
+void RenderThread::stop(){
+
+	mutex.lock();
+	stopping = true;
+	wakeUp.wakeOne();
+	mutex.unlock();
+
+	wait();
+}
+
+/**
+ * @brief Run.
+ *
+ * Initializes the context in this thread and renders until stopped.
+ */
+void RenderThread::run(){
+
+	widget->makeCurrent();
+	widget->glInit();
+
+	forever{
+
+		mutex.lock();
+		while(!stopping && !resizePending && !framePending)
+			wakeUp.wait(&mutex);
+
+		bool resized = resizePending;
+		int width = pendingWidth;
+		int height = pendingHeight;
+		resizePending = false;
+		framePending = false;
+		bool stopped = stopping;
+		mutex.unlock();
+
+		if(stopped)
+			break;
+
+		if(resized)
+			widget->resizeGL(width, height);
+
+		widget->paintGL();
+		widget->swapBuffers();
+		widget->framePresented();
+	}
+
+	widget->doneCurrent();
+}
@@ -0,0 +1,83 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   renderthread.h
+ * @author Rafael Palomar
+ * @date   Mon Jun  7 11:03:26 2010
+ *
+ * @brief  RenderThread class header.
+ *
+ * This file contains the declaration of the class RenderThread.
+ *
+ */
+
+#ifndef RENDERTHREAD_H
+#define RENDERTHREAD_H
+
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include "scenestate.h"
+#include "triplebuffer.h"
+
+class GLWidget;
+
+//!Class RenderThread.
+/*!
+ * Owns the GL context of a GLWidget and renders its frames, so a slow
+ * frame never blocks the user interface. The GUI thread posts copies of
+ * the scene state and new sizes; the thread renders whenever there is
+ * something new and sleeps otherwise. Swaps wait for the display, which
+ * paces the frames.
+ *
+ * Scene states go through a triple buffer, so posting one never waits
+ * for the frame being rendered and every frame starts from the latest
+ * state posted. The mutex only guards the wake up flags.
+ */
+class RenderThread: public QThread{
+
+  private:
+	GLWidget *widget;
+	QMutex mutex;
+	QWaitCondition wakeUp;
+	TripleBuffer<SceneState> states;
+	int pendingWidth;
+	int pendingHeight;
+	bool resizePending;
+	bool framePending;
+	bool stopping;
+
+  protected:
+	void run();
+
+  public:
+	RenderThread(GLWidget *widget);
+
+	void post(const SceneState &state);
+	bool take();
+	const SceneState &state() const;
+	void resize(int width, int height);
+	void requestFrame();
+	void stop();
+
+}; //END class RenderThread.
+
+#endif
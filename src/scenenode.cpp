@@ -0,0 +1,324 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   scenenode.cpp
+ * @author Rafael Palomar
+ * @date   Tue Jun  1 11:40:13 2010
+ *
+ * @brief  SceneNode class definition.
+ *
+ * This file contains the definition of the SceneNode class.
+ *
+ */
+
+#include "scenenode.h"
+
+/**
+ * @brief Default constructor.
+ *
+ * The node starts with the identity transform and no geometry.
+ */
+SceneNode::SceneNode(){
+
+	parentNode = 0;
+	worldDirty = true;
+	boundRadius = -1.0f;
+	worldRadius = -1.0f;
+	subtreeRadius = -1.0f;
+	boundsDirty = true;
+	enabled = true;
+}
+
+/**
+ * @brief Destructor.
+ *
+ * Deletes the children.
+ */
+SceneNode::~SceneNode(){
+
+	qDeleteAll(childNodes);
+}
+
+/**
+ * @brief Add a child.
+ *
+ * The node takes ownership of the child. Children are rendered in the
+ * order they were added.
+ *
+ * @param child a node without parent.
+ */
+void SceneNode::addChild(SceneNode *child){
+
+	child->parentNode = this;
+	childNodes.append(child);
+	child->invalidateWorld();
+}
+
+/**
+ * @brief Parent.
+ *
+ * @return the parent node, 0 for the root.
+ */
+SceneNode *SceneNode::parent() const{
+
+	return parentNode;
+}
+
+/**
+ * @brief Set transform.
+ *
+ * @param transform the transform relative to the parent.
+ */
+void SceneNode::setTransform(const Mat4 &transform){
+
+	localMatrix = transform;
+	invalidateWorld();
+}
+
+/**
+ * @brief Transform.
+ *
+ * @return the transform relative to the parent.
+ */
+const Mat4 &SceneNode::transform() const{
+
+	return localMatrix;
+}
+
+/**
+ * @brief World transform.
+ *
+ * @return the transform relative to the root.
+ */
+const Mat4 &SceneNode::worldTransform(){
+
+	updateWorld();
+	return worldMatrix;
+}
+
+/**
+ * @brief Set bounds.
+ *
+ * @param center center of the bounding sphere of the geometry, in the
+ * coordinates of the node.
+ * @param radius radius of the sphere, negative if the node draws nothing.
+ */
+void SceneNode::setBounds(const Vec4 &center, float radius){
+
+	boundCenter = center;
+	boundRadius = radius;
+	invalidateWorld();
+}
+
+/**
+ * @brief Set enabled.
+ *
+ * Disabled nodes are not rendered, nor are their children.
+ *
+ * @param enable whether the node is rendered.
+ */
+void SceneNode::setEnabled(bool enable){
+
+	enabled = enable;
+}
+
+/**
+ * @brief Enabled.
+ *
+ * @return true if the node is rendered.
+ */
+bool SceneNode::isEnabled() const{
+
+	return enabled;
+}
+
+/**
+ * @brief Render.
+ *
+ * Draws the visible nodes of the subtree, parents before children.
+ *
+ * @param frustum the view frustum, in the space of the root.
+ *
+ * @return the number of nodes drawn.
+ */
+int SceneNode::render(const Frustum &frustum){
+
+	int drawn = 0;
+
+	updateBounds();
+	render(frustum, false, drawn);
+
+	return drawn;
+}
+
+/**
+ * @brief Draw geometry.
+ *
+ * Draws the geometry of the node; the base node draws nothing.
+ *
+ * @param world the world matrix of the node.
+ */
+void SceneNode::drawGeometry(const GLfloat *world){
+
+	Q_UNUSED(world);
+}
+
+/**
+ * @brief Invalidate world.
+ *
+ * Marks the world matrix of the subtree as out of date, and the bounds of
+ * the subtree and of its ancestors.
+ *
+ */
+void SceneNode::invalidateWorld(){
+
+	worldDirty = true;
+	boundsDirty = true;
+
+	for(int i = 0; i < childNodes.size(); i++)
+		childNodes[i]->invalidateWorld();
+
+	for(SceneNode *node = parentNode; node && !node->boundsDirty; node = node->parentNode)
+		node->boundsDirty = true;
+}
+
+/**
+ * @brief Update world.
+ *
+ */
+void SceneNode::updateWorld(){
+
+	if(!worldDirty)
+		return;
+
+	if(parentNode){
+		parentNode->updateWorld();
+		worldMatrix = parentNode->worldMatrix * localMatrix;
+	}
+	else
+		worldMatrix = localMatrix;
+
+	worldDirty = false;
+}
+
+/**
+ * @brief Update bounds.
+ *
+ * Computes the world bounding sphere of the geometry and the sphere that
+ * encloses the whole subtree.
+ *
+ */
+void SceneNode::updateBounds(){
+
+	if(!boundsDirty)
+		return;
+
+	updateWorld();
+
+	worldRadius = -1.0f;
+	if(boundRadius >= 0.0f){
+
+		float scale = 0.0f;
+		for(int i = 0; i < 3; i++)
+			scale = qMax(scale, worldMatrix.column(i).length3());
+
+		worldCenter = worldMatrix*boundCenter;
+		worldRadius = boundRadius*scale;
+	}
+
+	subtreeCenter = worldCenter;
+	subtreeRadius = worldRadius;
+
+	for(int i = 0; i < childNodes.size(); i++){
+		childNodes[i]->updateBounds();
+		merge(subtreeCenter, subtreeRadius,
+			  childNodes[i]->subtreeCenter, childNodes[i]->subtreeRadius);
+	}
+
+	boundsDirty = false;
+}
+
+/**
+ * @brief Render subtree.
+ *
+ * @param frustum the view frustum, in the space of the root.
+ * @param inside whether the parent is known to be inside the frustum.
+ * @param drawn number of nodes drawn so far.
+ */
+void SceneNode::render(const Frustum &frustum, bool inside, int &drawn){
+
+	if(!enabled || subtreeRadius < 0.0f)
+		return;
+
+	if(!inside){
+		Frustum::Containment containment = frustum.classify(subtreeCenter, subtreeRadius);
+		if(containment == Frustum::Outside)
+			return;
+		inside = containment == Frustum::Inside;
+	}
+
+	if(worldRadius >= 0.0f
+	   && (inside || frustum.classify(worldCenter, worldRadius) != Frustum::Outside)){
+		drawGeometry(worldMatrix.data());
+		drawn++;
+	}
+
+	for(int i = 0; i < childNodes.size(); i++)
+		childNodes[i]->render(frustum, inside, drawn);
+}
+
+/**
+ * @brief Merge spheres.
+ *
+ * Grows a sphere to enclose another one.
+ *
+ * @param center center of the sphere to grow.
+ * @param radius radius of the sphere to grow, negative if empty.
+ * @param otherCenter center of the sphere to enclose.
+ * @param otherRadius radius of the sphere to enclose, negative if empty.
+ */
+void SceneNode::merge(Vec4 &center, float &radius,
+					  const Vec4 &otherCenter, float otherRadius){
+
+	if(otherRadius < 0.0f)
+		return;
+
+	if(radius < 0.0f){
+		center = otherCenter;
+		radius = otherRadius;
+		return;
+	}
+
+	Vec4 offset = otherCenter - center;
+	float distance = offset.length3();
+
+	if(distance + otherRadius <= radius)
+		return;
+
+	if(distance + radius <= otherRadius){
+		center = otherCenter;
+		radius = otherRadius;
+		return;
+	}
+
+	float merged = (distance + radius + otherRadius)/2.0f;
+	center = center + offset*((merged - radius)/distance);
+	radius = merged;
+}
@@ -0,0 +1,151 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   scenenode.h
+ * @author Rafael Palomar
+ * @date   Tue Jun  1 11:02:45 2010
+ *
+ * @brief  SceneNode class header.
+ *
+ * This file contains the declaration of the class SceneNode and the
+ * class template SceneCallbackNode.
+ *
+ */
+
+#ifndef SCENENODE_H
+#define SCENENODE_H
+
+#include <QList>
+#include <QtOpenGL>
+
+#include "frustum.h"
+#include "simdmath.h"
+
+//!Class SceneNode.
+/*!
+ * Node of the scene graph. Each node has a transform relative to its
+ * parent and, if it draws something, a bounding sphere of its geometry.
+ *
+ * World matrices and the bounding spheres of whole subtrees are cached
+ * and only computed again after a transform changes. With the view as the
+ * transform of the root, world matrices are the model view matrices and
+ * the frustum is the one of the projection alone. Rendering skips
+ * every subtree whose bounding sphere is outside the view frustum, and
+ * stops testing below a subtree that is completely inside it.
+ */
+class SceneNode{
+
+  private:
+	SceneNode *parentNode;
+	QList<SceneNode *> childNodes;
+	Mat4 localMatrix;
+	Mat4 worldMatrix;
+	bool worldDirty;
+	Vec4 boundCenter;
+	float boundRadius;
+	Vec4 worldCenter;
+	float worldRadius;
+	Vec4 subtreeCenter;
+	float subtreeRadius;
+	bool boundsDirty;
+	bool enabled;
+
+	Q_DISABLE_COPY(SceneNode);
+
+	void invalidateWorld();
+	void updateWorld();
+	void updateBounds();
+	void render(const Frustum &frustum, bool inside, int &drawn);
+	static void merge(Vec4 &center, float &radius,
+					  const Vec4 &otherCenter, float otherRadius);
+
+  protected:
+	virtual void drawGeometry(const GLfloat *world);
+
+  public:
+	SceneNode();
+	virtual ~SceneNode();
+
+	void addChild(SceneNode *child);
+	SceneNode *parent() const;
+
+	void setTransform(const Mat4 &transform);
+	const Mat4 &transform() const;
+	const Mat4 &worldTransform();
+
+	void setBounds(const Vec4 &center, float radius);
+	void setEnabled(bool enable);
+	bool isEnabled() const;
+
+	int render(const Frustum &frustum);
+
+}; //END class SceneNode.
+
+//!Class template SceneCallbackNode.
+/*!
+ * Scene node whose geometry is drawn by a member function of another
+ * object, which receives the world matrix of the node.
+ */
+template<class T>
+class SceneCallbackNode: public SceneNode{
+
+  public:
+	typedef void (T::*DrawFunction)(const GLfloat *world);
+
+  private:
+	T *object;
+	DrawFunction function;
+
+  protected:
+	/**
+	 * @brief Draw geometry.
+	 *
+	 * @param world the world matrix of the node.
+	 */
+	void drawGeometry(const GLfloat *world){
+
+		(object->*function)(world);
+	}
+
+  public:
+	/**
+	 * @brief Constructor.
+	 *
+	 * @param object the object that draws the node.
+	 * @param function the member function that draws the node.
+	 */
+	SceneCallbackNode(T *object, DrawFunction function):
+		object(object), function(function){
+
+	}
+
+	/**
+	 * @brief Set function.
+	 *
+	 * @param function the member function that draws the node.
+	 */
+	void setFunction(DrawFunction function){
+
+		this->function = function;
+	}
+
+}; //END class SceneCallbackNode.
+
+#endif
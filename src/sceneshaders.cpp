@@ -0,0 +1,300 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   sceneshaders.cpp
+ * @author Rafael Palomar
+ * @date   Wed Jun  2 11:05:12 2010
+ *
+ * @brief  SceneShaders class definition.
+ *
+ * This file contains the definition of the SceneShaders class.
+ *
+ */
+
+#include "sceneshaders.h"
+#include "programcache.h"
+
+#include <QGLShaderProgram>
+
+#include <cstring>
+
+#ifndef GL_UNIFORM_BUFFER
+#define GL_UNIFORM_BUFFER 0x8A11
+#endif
+
+#ifndef GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+#define GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT 0x8A34
+#endif
+
+#ifndef GL_INVALID_INDEX
+#define GL_INVALID_INDEX 0xFFFFFFFFu
+#endif
+
+//!Binding point of the SceneParameters block.
+static const GLuint parameterBinding = 0;
+
+//!Declarations shared by both stages.
+static const char *commonSource =
+	"#extension GL_ARB_uniform_buffer_object : require\n"
+	"layout(std140) uniform SceneParameters{\n"
+	"	mat4 projection;\n"
+	"	vec4 ambientLight;\n"
+	"	vec4 diffuseLight;\n"
+	"	vec4 lightModelAmbient;\n"
+	"	vec4 lightPosition;\n"
+	"	vec4 fogColor;\n"
+	"	float fogEnd;\n"
+	"	float fogScale;\n"
+	"	float fog;\n"
+	"};\n"
+	"varying vec4 color;\n"
+	"varying vec2 texCoord;\n"
+	"varying float fogDepth;\n";
+
+//!Vertex shader: light 1 with the material taken from the vertex color,
+//!transformed by the model view matrix of the node.
+static const char *vertexShaderSource =
+	"uniform mat4 modelView;\n"
+	"void main(){\n"
+	"	vec4 position = modelView * gl_Vertex;\n"
+	"	color = gl_Color;\n"
+	"#if LIGHTING\n"
+	"	vec3 normal = normalize(mat3(modelView) * gl_Normal);\n"
+	"	vec3 light = normalize(lightPosition.xyz - position.xyz);\n"
+	"	//Clamped as the fixed function clamps it, before texturing.\n"
+	"	color.rgb = clamp(color.rgb * (lightModelAmbient.rgb + ambientLight.rgb\n"
+	"		+ diffuseLight.rgb * max(dot(normal, light), 0.0)), 0.0, 1.0);\n"
+	"#endif\n"
+	"#if TEXTURING\n"
+	"	texCoord = gl_MultiTexCoord0.st;\n"
+	"#endif\n"
+	"	fogDepth = abs(position.z);\n"
+	"	gl_Position = projection * position;\n"
+	"}\n";
+
+//!Fragment shader: texture modulation and linear fog.
+static const char *fragmentShaderSource =
+	"uniform sampler2D sceneTexture;\n"
+	"void main(){\n"
+	"	gl_FragColor = color;\n"
+	"#if TEXTURING\n"
+	"	gl_FragColor *= texture2D(sceneTexture, texCoord);\n"
+	"#endif\n"
+	"	if(fog > 0.5){\n"
+	"		float factor = clamp((fogEnd - fogDepth)*fogScale, 0.0, 1.0);\n"
+	"		gl_FragColor.rgb = mix(fogColor.rgb, gl_FragColor.rgb, factor);\n"
+	"	}\n"
+	"}\n";
+
+/**
+ * @brief Default constructor.
+ *
+ */
+SceneShaders::SceneShaders(){
+
+	available = false;
+	getUniformBlockIndex = 0;
+	uniformBlockBinding = 0;
+	bindBufferRange = 0;
+	parameterBuffer = 0;
+	blockStride = sizeof(Parameters);
+	boundVariant = Plain;
+
+	for(int i = 0; i < VariantCount; i++){
+		programs[i] = 0;
+		modelViewLocations[i] = -1;
+	}
+}
+
+/**
+ * @brief Destructor.
+ *
+ * The context of the programs must be current.
+ */
+SceneShaders::~SceneShaders(){
+
+	deletePrograms();
+}
+
+/**
+ * @brief Initialize.
+ *
+ * Resolves the uniform buffer entry points and builds the programs. Must
+ * be called with the context current.
+ *
+ * @param context the GL context the scene is drawn in.
+ * @param programCache the cache the programs are built through.
+ */
+void SceneShaders::initialize(const QGLContext *context, ProgramCache &programCache){
+
+	deletePrograms();
+
+	QByteArray extensions((const char *)glGetString(GL_EXTENSIONS));
+
+	getUniformBlockIndex = (GetUniformBlockIndex)context->getProcAddress("glGetUniformBlockIndex");
+	uniformBlockBinding = (UniformBlockBinding)context->getProcAddress("glUniformBlockBinding");
+	bindBufferRange = (BindBufferRange)context->getProcAddress("glBindBufferRange");
+
+	available = QGLShaderProgram::hasOpenGLShaderPrograms()
+		&& extensions.contains("GL_ARB_uniform_buffer_object")
+		&& getUniformBlockIndex && uniformBlockBinding && bindBufferRange;
+
+	for(int i = 0; available && i < VariantCount; i++)
+		available = createProgram((Variant)i, programCache);
+
+	if(!available){
+		deletePrograms();
+		return;
+	}
+
+	glFunctions.initializeGLFunctions(context);
+
+	//Each copy of the block starts at an offset the GL can bind.
+	GLint alignment = 1;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	alignment = qMax(alignment, 1);
+	blockStride = (sizeof(Parameters) + alignment - 1)/alignment*alignment;
+	blocks.fill(0, 2*blockStride);
+
+	glFunctions.glGenBuffers(1, &parameterBuffer);
+	glFunctions.glBindBuffer(GL_UNIFORM_BUFFER, parameterBuffer);
+	glFunctions.glBufferData(GL_UNIFORM_BUFFER, blocks.size(), 0, GL_DYNAMIC_DRAW);
+	glFunctions.glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+/**
+ * @brief Available.
+ *
+ * @return true if the programs were built, false if the scene has to be
+ * drawn with the fixed function pipeline.
+ */
+bool SceneShaders::isAvailable() const{
+
+	return available;
+}
+
+/**
+ * @brief Set parameters.
+ *
+ * Uploads the parameters of the frame, with a single buffer update.
+ *
+ * @param parameters the parameters of the scene.
+ * @param mirrored the parameters of the reflection.
+ */
+void SceneShaders::setParameters(const Parameters &parameters, const Parameters &mirrored){
+
+	memcpy(blocks.data(), &parameters, sizeof(Parameters));
+	memcpy(blocks.data() + blockStride, &mirrored, sizeof(Parameters));
+
+	glFunctions.glBindBuffer(GL_UNIFORM_BUFFER, parameterBuffer);
+	glFunctions.glBufferSubData(GL_UNIFORM_BUFFER, 0, blocks.size(), blocks.constData());
+	glFunctions.glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+/**
+ * @brief Bind.
+ *
+ * Makes a program current along with the parameters it reads.
+ *
+ * @param variant the program.
+ * @param mirrored whether the parameters of the reflection are used.
+ */
+void SceneShaders::bind(Variant variant, bool mirrored){
+
+	programs[variant]->bind();
+	bindBufferRange(GL_UNIFORM_BUFFER, parameterBinding, parameterBuffer,
+					mirrored ? blockStride : 0, sizeof(Parameters));
+	boundVariant = variant;
+}
+
+/**
+ * @brief Set model view.
+ *
+ * Sets the model view matrix of the program made current by bind().
+ *
+ * @param modelView the matrix, by columns.
+ */
+void SceneShaders::setModelView(const GLfloat *modelView){
+
+	glFunctions.glUniformMatrix4fv(modelViewLocations[boundVariant], 1, GL_FALSE, modelView);
+}
+
+/**
+ * @brief Release.
+ *
+ * Goes back to the fixed function pipeline.
+ */
+void SceneShaders::release(){
+
+	if(available)
+		programs[Plain]->release();
+}
+
+/**
+ * @brief Delete programs.
+ *
+ */
+void SceneShaders::deletePrograms(){
+
+	for(int i = 0; i < VariantCount; i++){
+		delete programs[i];
+		programs[i] = 0;
+	}
+
+	if(parameterBuffer){
+		glFunctions.glDeleteBuffers(1, &parameterBuffer);
+		parameterBuffer = 0;
+	}
+}
+
+/**
+ * @brief Create program.
+ *
+ * @param variant the program to build.
+ * @param programCache the cache the program is built through.
+ *
+ * @return true if the program was linked.
+ */
+bool SceneShaders::createProgram(Variant variant, ProgramCache &programCache){
+
+	QByteArray defines = "#version 120\n";
+	defines += QByteArray("#define LIGHTING ") + (variant == Lit || variant == LitTextured ? "1\n" : "0\n");
+	defines += QByteArray("#define TEXTURING ") + (variant == Textured || variant == LitTextured ? "1\n" : "0\n");
+	defines += commonSource;
+
+	QGLShaderProgram *program = new QGLShaderProgram;
+	programs[variant] = program;
+
+	if(!programCache.build(program, defines + vertexShaderSource, defines + fragmentShaderSource))
+		return false;
+
+	GLuint block = getUniformBlockIndex(program->programId(), "SceneParameters");
+	if(block == GL_INVALID_INDEX)
+		return false;
+	uniformBlockBinding(program->programId(), block, parameterBinding);
+
+	modelViewLocations[variant] = program->uniformLocation("modelView");
+
+	program->bind();
+	program->setUniformValue("sceneTexture", 0);
+	program->release();
+
+	return true;
+}
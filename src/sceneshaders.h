@@ -0,0 +1,119 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   sceneshaders.h
+ * @author Rafael Palomar
+ * @date   Wed Jun  2 10:21:37 2010
+ *
+ * @brief  SceneShaders class header.
+ *
+ * This file contains the declaration of the class SceneShaders.
+ *
+ */
+
+#ifndef SCENESHADERS_H
+#define SCENESHADERS_H
+
+#include <QByteArray>
+#include <QGLFunctions>
+#include <QtOpenGL>
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+class QGLShaderProgram;
+class ProgramCache;
+
+//!Class SceneShaders.
+/*!
+ * GLSL replacement for the fixed function light 1, color material, linear
+ * fog and texture modulation used by the scene. The four programs are
+ * built from the same sources, with and without lighting and texturing;
+ * whether the scene is lit picks the program, not a uniform.
+ *
+ * Every parameter lives in the SceneParameters uniform block, which is
+ * written once per frame, except the model view matrix of each node, a
+ * uniform of its own. Both matrices come from the CPU, so the programs do
+ * not read the fixed function matrix stacks. The buffer holds two copies of the block, the
+ * second one with the light mirrored for the reflection, so switching to
+ * the reflection only binds another range of the buffer.
+ */
+class SceneShaders{
+
+  public:
+	//!Programs of the set.
+	enum Variant{
+		Plain,        //!< Vertex color.
+		Textured,     //!< Vertex color modulated by the texture.
+		Lit,          //!< Lit vertex color.
+		LitTextured,  //!< Lit vertex color modulated by the texture.
+		VariantCount
+	};
+
+	//!Contents of the SceneParameters block, in std140 layout.
+	struct Parameters{
+		GLfloat projection[16];       //!< By columns.
+		GLfloat ambientLight[4];
+		GLfloat diffuseLight[4];
+		GLfloat lightModelAmbient[4];
+		GLfloat lightPosition[4];     //!< In eye coordinates.
+		GLfloat fogColor[4];
+		GLfloat fogEnd;
+		GLfloat fogScale;             //!< 1/(fog end - fog start).
+		GLfloat fog;                  //!< 1 if fog is enabled.
+		GLfloat padding;              //!< Rounds the block up to a whole vec4.
+	};
+
+  private:
+	typedef GLuint (APIENTRY *GetUniformBlockIndex)(GLuint program, const char *name);
+	typedef void (APIENTRY *UniformBlockBinding)(GLuint program, GLuint index, GLuint binding);
+	typedef void (APIENTRY *BindBufferRange)(GLenum target, GLuint index, GLuint buffer,
+											 GLintptr offset, GLsizeiptr size);
+
+	bool available;
+	GetUniformBlockIndex getUniformBlockIndex;
+	UniformBlockBinding uniformBlockBinding;
+	BindBufferRange bindBufferRange;
+	QGLFunctions glFunctions;
+	QGLShaderProgram *programs[VariantCount];
+	GLint modelViewLocations[VariantCount];
+	Variant boundVariant;
+	GLuint parameterBuffer;
+	int blockStride;
+	QByteArray blocks;
+
+	void deletePrograms();
+	bool createProgram(Variant variant, ProgramCache &programCache);
+
+  public:
+	SceneShaders();
+	~SceneShaders();
+
+	void initialize(const QGLContext *context, ProgramCache &programCache);
+	bool isAvailable() const;
+	void setParameters(const Parameters &parameters, const Parameters &mirrored);
+	void bind(Variant variant, bool mirrored = false);
+	void setModelView(const GLfloat *modelView);
+	void release();
+
+}; //END class SceneShaders.
+
+#endif
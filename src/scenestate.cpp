@@ -0,0 +1,59 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   scenestate.cpp
+ * @author Rafael Palomar
+ * @date   Mon Jun  7 09:58:02 2010
+ *
+ * @brief  SceneState structure definition.
+ *
+ * This file contains the definition of the SceneState structure.
+ *
+ */
+
+#include "scenestate.h"
+
+/**
+ * @brief Default constructor.
+ *
+ * Black cube and lights, black fog and every effect off.
+ */
+SceneState::SceneState(){
+
+	for(int i = 0; i < 3; i++)
+		cubeColor[i] = 0;
+
+	for(int i = 0; i < 4; i++){
+		ambientLight[i] = 0.0f;
+		diffuseLight[i] = 0.0f;
+		fogColor[i] = 0.0f;
+	}
+	fogColor[3] = 1.0f;
+
+	fogStart = 0.0f;
+	fogEnd = 0.0f;
+	lighting = false;
+	reflection = false;
+	fog = false;
+	instances = 0;
+	profiling = false;
+	inputEvents = 0;
+	inputTime = 0;
+}
@@ -0,0 +1,69 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   scenestate.h
+ * @author Rafael Palomar
+ * @date   Mon Jun  7 09:41:18 2010
+ *
+ * @brief  SceneState structure header.
+ *
+ * This file contains the declaration of the SceneState structure.
+ *
+ */
+
+#ifndef SCENESTATE_H
+#define SCENESTATE_H
+
+#include <QString>
+
+#include "simdmath.h"
+#include "textureloader.h"
+
+//!Parameters of the scene set from the user interface.
+/*!
+ * The slots of GLWidget write them and every frame is rendered from a
+ * copy, so they can be changed while another thread renders. Textures
+ * are named by their texture cache key; the decoded image comes along
+ * until the renderer has uploaded it.
+ */
+struct SceneState{
+	Quat orientation;              //!< Rotation of the cube.
+	int cubeColor[3];              //!< 0-255.
+	float ambientLight[4];
+	float diffuseLight[4];
+	float fogColor[4];
+	float fogStart;
+	float fogEnd;
+	bool lighting;
+	bool reflection;
+	bool fog;
+	int instances;                 //!< Cubes of the lattice, 0 for the single cube.
+	bool profiling;
+	QString cubeTextureKey;        //!< Empty if the cube is not textured.
+	TextureImage cubeTextureImage; //!< Null if the texture is cached or still loading.
+	QString floorTextureKey;       //!< Empty if the floor is not textured.
+	TextureImage floorTextureImage;//!< Null if the texture is cached or still loading.
+	int inputEvents;               //!< Mouse motion events folded into this state.
+	qint64 inputTime;              //!< Arrival of the first of them, on GLWidget's input clock (ns).
+
+	SceneState();
+};
+
+#endif
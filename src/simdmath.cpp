@@ -0,0 +1,586 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   simdmath.cpp
+ * @author Rafael Palomar
+ * @date   Fri Jun  4 10:15:08 2010
+ *
+ * @brief  Vec4, Mat4 and Quat classes definition.
+ *
+ * This file contains the definition of the Vec4, Mat4 and Quat classes.
+ *
+ */
+
+#include "simdmath.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define SIMDMATH_SSE
+#include <xmmintrin.h>
+#endif
+
+static const float degreesToRadians = 3.14159265358979f/180.0f;
+
+/**
+ * @brief SIMD enabled.
+ *
+ * @return true if the products are computed with SSE.
+ */
+bool simdEnabled(){
+
+#ifdef SIMDMATH_SSE
+	return true;
+#else
+	return false;
+#endif
+}
+
+/**
+ * @brief Default constructor.
+ *
+ * The vector starts as the origin point.
+ */
+Vec4::Vec4(){
+
+	v[0] = 0.0f;
+	v[1] = 0.0f;
+	v[2] = 0.0f;
+	v[3] = 1.0f;
+}
+
+/**
+ * @brief Constructor.
+ *
+ * @param x x component.
+ * @param y y component.
+ * @param z z component.
+ * @param w w component.
+ */
+Vec4::Vec4(float x, float y, float z, float w){
+
+	v[0] = x;
+	v[1] = y;
+	v[2] = z;
+	v[3] = w;
+}
+
+/**
+ * @brief X.
+ *
+ * @return the x component.
+ */
+float Vec4::x() const{
+
+	return v[0];
+}
+
+/**
+ * @brief Y.
+ *
+ * @return the y component.
+ */
+float Vec4::y() const{
+
+	return v[1];
+}
+
+/**
+ * @brief Z.
+ *
+ * @return the z component.
+ */
+float Vec4::z() const{
+
+	return v[2];
+}
+
+/**
+ * @brief W.
+ *
+ * @return the w component.
+ */
+float Vec4::w() const{
+
+	return v[3];
+}
+
+/**
+ * @brief Addition.
+ *
+ * @param other the vector to add.
+ *
+ * @return the sum of both vectors.
+ */
+Vec4 Vec4::operator+(const Vec4 &other) const{
+
+	return Vec4(v[0] + other.v[0], v[1] + other.v[1], v[2] + other.v[2], v[3] + other.v[3]);
+}
+
+/**
+ * @brief Subtraction.
+ *
+ * @param other the vector to subtract.
+ *
+ * @return the difference of both vectors.
+ */
+Vec4 Vec4::operator-(const Vec4 &other) const{
+
+	return Vec4(v[0] - other.v[0], v[1] - other.v[1], v[2] - other.v[2], v[3] - other.v[3]);
+}
+
+/**
+ * @brief Scaling.
+ *
+ * @param factor the scale factor.
+ *
+ * @return the vector scaled.
+ */
+Vec4 Vec4::operator*(float factor) const{
+
+	return Vec4(v[0]*factor, v[1]*factor, v[2]*factor, v[3]*factor);
+}
+
+/**
+ * @brief Length.
+ *
+ * @return the length of the x, y, z part.
+ */
+float Vec4::length3() const{
+
+	return sqrtf(dot3(*this, *this));
+}
+
+/**
+ * @brief Dot product.
+ *
+ * @param a first vector.
+ * @param b second vector.
+ *
+ * @return the dot product of the x, y, z parts.
+ */
+float Vec4::dot3(const Vec4 &a, const Vec4 &b){
+
+	return a.v[0]*b.v[0] + a.v[1]*b.v[1] + a.v[2]*b.v[2];
+}
+
+/**
+ * @brief Default constructor.
+ *
+ * The matrix starts as the identity.
+ */
+Mat4::Mat4(){
+
+	for(int i = 0; i < 16; i++)
+		m[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+}
+
+/**
+ * @brief Translation.
+ *
+ * @param x translation along x.
+ * @param y translation along y.
+ * @param z translation along z.
+ *
+ * @return the translation matrix, as glTranslatef builds it.
+ */
+Mat4 Mat4::translation(float x, float y, float z){
+
+	Mat4 result;
+	result.m[12] = x;
+	result.m[13] = y;
+	result.m[14] = z;
+	return result;
+}
+
+/**
+ * @brief Scaling.
+ *
+ * @param x scale along x.
+ * @param y scale along y.
+ * @param z scale along z.
+ *
+ * @return the scaling matrix, as glScalef builds it.
+ */
+Mat4 Mat4::scaling(float x, float y, float z){
+
+	Mat4 result;
+	result.m[0] = x;
+	result.m[5] = y;
+	result.m[10] = z;
+	return result;
+}
+
+/**
+ * @brief Uniform scaling.
+ *
+ * @param factor scale along every axis.
+ *
+ * @return the scaling matrix.
+ */
+Mat4 Mat4::scaling(float factor){
+
+	return scaling(factor, factor, factor);
+}
+
+/**
+ * @brief Rotation.
+ *
+ * @param degrees the angle.
+ * @param x x component of the axis.
+ * @param y y component of the axis.
+ * @param z z component of the axis.
+ *
+ * @return the rotation matrix, as glRotatef builds it.
+ */
+Mat4 Mat4::rotation(float degrees, float x, float y, float z){
+
+	return Quat::fromAxisAngle(degrees, x, y, z).toMatrix();
+}
+
+/**
+ * @brief Perspective.
+ *
+ * @param fovy vertical field of view, in degrees.
+ * @param aspect width over height.
+ * @param nearPlane distance to the near plane.
+ * @param farPlane distance to the far plane.
+ *
+ * @return the projection matrix, as gluPerspective builds it.
+ */
+Mat4 Mat4::perspective(float fovy, float aspect, float nearPlane, float farPlane){
+
+	float f = 1.0f/tanf(fovy*degreesToRadians/2.0f);
+
+	Mat4 result;
+	result.m[0] = f/aspect;
+	result.m[5] = f;
+	result.m[10] = (farPlane + nearPlane)/(nearPlane - farPlane);
+	result.m[11] = -1.0f;
+	result.m[14] = 2.0f*farPlane*nearPlane/(nearPlane - farPlane);
+	result.m[15] = 0.0f;
+	return result;
+}
+
+/**
+ * @brief Product.
+ *
+ * @param other the matrix on the right.
+ *
+ * @return this matrix times other.
+ */
+Mat4 Mat4::operator*(const Mat4 &other) const{
+
+	Mat4 result;
+	multiply(m, other.m, result.m);
+	return result;
+}
+
+/**
+ * @brief Transform.
+ *
+ * @param vector the vector.
+ *
+ * @return the vector transformed by this matrix.
+ */
+Vec4 Mat4::operator*(const Vec4 &vector) const{
+
+	Vec4 result;
+	transform(m, vector.v, result.v);
+	return result;
+}
+
+/**
+ * @brief Row.
+ *
+ * @param i index of the row.
+ *
+ * @return the row.
+ */
+Vec4 Mat4::row(int i) const{
+
+	return Vec4(m[i], m[4 + i], m[8 + i], m[12 + i]);
+}
+
+/**
+ * @brief Column.
+ *
+ * @param i index of the column.
+ *
+ * @return the column.
+ */
+Vec4 Mat4::column(int i) const{
+
+	return Vec4(m[4*i], m[4*i + 1], m[4*i + 2], m[4*i + 3]);
+}
+
+/**
+ * @brief Data.
+ *
+ * @return the sixteen elements, column by column.
+ */
+const float *Mat4::data() const{
+
+	return m;
+}
+
+/**
+ * @brief Multiply matrices.
+ *
+ * Each column of the result is a combination of the columns of a, so it
+ * takes four multiplies and three additions of whole columns.
+ *
+ * @param a the matrix on the left.
+ * @param b the matrix on the right.
+ * @param result a times b; may be a or b.
+ */
+void Mat4::multiply(const float *a, const float *b, float *result){
+
+#ifdef SIMDMATH_SSE
+	__m128 a0 = _mm_loadu_ps(a);
+	__m128 a1 = _mm_loadu_ps(a + 4);
+	__m128 a2 = _mm_loadu_ps(a + 8);
+	__m128 a3 = _mm_loadu_ps(a + 12);
+	__m128 columns[4];
+
+	for(int j = 0; j < 4; j++){
+		__m128 column = _mm_mul_ps(a0, _mm_set1_ps(b[4*j]));
+		column = _mm_add_ps(column, _mm_mul_ps(a1, _mm_set1_ps(b[4*j + 1])));
+		column = _mm_add_ps(column, _mm_mul_ps(a2, _mm_set1_ps(b[4*j + 2])));
+		column = _mm_add_ps(column, _mm_mul_ps(a3, _mm_set1_ps(b[4*j + 3])));
+		columns[j] = column;
+	}
+
+	for(int j = 0; j < 4; j++)
+		_mm_storeu_ps(result + 4*j, columns[j]);
+#else
+	multiplyScalar(a, b, result);
+#endif
+}
+
+/**
+ * @brief Multiply matrices, scalar version.
+ *
+ * @param a the matrix on the left.
+ * @param b the matrix on the right.
+ * @param result a times b; may be a or b.
+ */
+void Mat4::multiplyScalar(const float *a, const float *b, float *result){
+
+	float product[16];
+
+	for(int j = 0; j < 4; j++)
+		for(int i = 0; i < 4; i++)
+			product[4*j + i] = a[i]*b[4*j] + a[4 + i]*b[4*j + 1]
+				+ a[8 + i]*b[4*j + 2] + a[12 + i]*b[4*j + 3];
+
+	memcpy(result, product, sizeof(product));
+}
+
+/**
+ * @brief Transform a vector.
+ *
+ * @param matrix the matrix.
+ * @param vector the vector.
+ * @param result the matrix times the vector; may be the vector.
+ */
+void Mat4::transform(const float *matrix, const float *vector, float *result){
+
+#ifdef SIMDMATH_SSE
+	__m128 product = _mm_mul_ps(_mm_loadu_ps(matrix), _mm_set1_ps(vector[0]));
+	product = _mm_add_ps(product, _mm_mul_ps(_mm_loadu_ps(matrix + 4), _mm_set1_ps(vector[1])));
+	product = _mm_add_ps(product, _mm_mul_ps(_mm_loadu_ps(matrix + 8), _mm_set1_ps(vector[2])));
+	product = _mm_add_ps(product, _mm_mul_ps(_mm_loadu_ps(matrix + 12), _mm_set1_ps(vector[3])));
+	_mm_storeu_ps(result, product);
+#else
+	transformScalar(matrix, vector, result);
+#endif
+}
+
+/**
+ * @brief Transform a vector, scalar version.
+ *
+ * @param matrix the matrix.
+ * @param vector the vector.
+ * @param result the matrix times the vector; may be the vector.
+ */
+void Mat4::transformScalar(const float *matrix, const float *vector, float *result){
+
+	float product[4];
+
+	for(int i = 0; i < 4; i++)
+		product[i] = matrix[i]*vector[0] + matrix[4 + i]*vector[1]
+			+ matrix[8 + i]*vector[2] + matrix[12 + i]*vector[3];
+
+	memcpy(result, product, sizeof(product));
+}
+
+/**
+ * @brief Default constructor.
+ *
+ * The quaternion starts as the identity rotation.
+ */
+Quat::Quat(){
+
+	q[0] = 0.0f;
+	q[1] = 0.0f;
+	q[2] = 0.0f;
+	q[3] = 1.0f;
+}
+
+/**
+ * @brief Constructor.
+ *
+ * @param x x component.
+ * @param y y component.
+ * @param z z component.
+ * @param w w component.
+ */
+Quat::Quat(float x, float y, float z, float w){
+
+	q[0] = x;
+	q[1] = y;
+	q[2] = z;
+	q[3] = w;
+}
+
+/**
+ * @brief From axis and angle.
+ *
+ * @param degrees the angle.
+ * @param x x component of the axis.
+ * @param y y component of the axis.
+ * @param z z component of the axis.
+ *
+ * @return the rotation around the axis, which need not be normalized.
+ */
+Quat Quat::fromAxisAngle(float degrees, float x, float y, float z){
+
+	float length = sqrtf(x*x + y*y + z*z);
+	if(length == 0.0f)
+		return Quat();
+
+	float half = degrees*degreesToRadians/2.0f;
+	float s = sinf(half)/length;
+
+	return Quat(x*s, y*s, z*s, cosf(half));
+}
+
+/**
+ * @brief Product.
+ *
+ * @param other the rotation applied first.
+ *
+ * @return the rotation of other followed by this one.
+ */
+Quat Quat::operator*(const Quat &other) const{
+
+	Quat result;
+	multiply(q, other.q, result.q);
+	return result;
+}
+
+/**
+ * @brief Normalized.
+ *
+ * @return the quaternion scaled to unit length.
+ */
+Quat Quat::normalized() const{
+
+	float length = sqrtf(q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3]);
+	if(length == 0.0f)
+		return Quat();
+
+	return Quat(q[0]/length, q[1]/length, q[2]/length, q[3]/length);
+}
+
+/**
+ * @brief To matrix.
+ *
+ * @return the rotation matrix of the quaternion, which must be unit.
+ */
+Mat4 Quat::toMatrix() const{
+
+	float x = q[0], y = q[1], z = q[2], w = q[3];
+
+	Mat4 result;
+	result.m[0] = 1.0f - 2.0f*(y*y + z*z);
+	result.m[1] = 2.0f*(x*y + z*w);
+	result.m[2] = 2.0f*(x*z - y*w);
+	result.m[4] = 2.0f*(x*y - z*w);
+	result.m[5] = 1.0f - 2.0f*(x*x + z*z);
+	result.m[6] = 2.0f*(y*z + x*w);
+	result.m[8] = 2.0f*(x*z + y*w);
+	result.m[9] = 2.0f*(y*z - x*w);
+	result.m[10] = 1.0f - 2.0f*(x*x + y*y);
+	return result;
+}
+
+/**
+ * @brief Multiply quaternions.
+ *
+ * The Hamilton product is w(a) times b plus three shuffles of b, with
+ * their signs flipped, scaled by x(a), y(a) and z(a).
+ *
+ * @param a the quaternion on the left.
+ * @param b the quaternion on the right.
+ * @param result a times b; may be a or b.
+ */
+void Quat::multiply(const float *a, const float *b, float *result){
+
+#ifdef SIMDMATH_SSE
+	__m128 right = _mm_loadu_ps(b);
+
+	__m128 product = _mm_mul_ps(_mm_set1_ps(a[3]), right);
+	product = _mm_add_ps(product, _mm_mul_ps(
+		_mm_mul_ps(_mm_set1_ps(a[0]), _mm_shuffle_ps(right, right, _MM_SHUFFLE(0, 1, 2, 3))),
+		_mm_set_ps(-1.0f, 1.0f, -1.0f, 1.0f)));
+	product = _mm_add_ps(product, _mm_mul_ps(
+		_mm_mul_ps(_mm_set1_ps(a[1]), _mm_shuffle_ps(right, right, _MM_SHUFFLE(1, 0, 3, 2))),
+		_mm_set_ps(-1.0f, -1.0f, 1.0f, 1.0f)));
+	product = _mm_add_ps(product, _mm_mul_ps(
+		_mm_mul_ps(_mm_set1_ps(a[2]), _mm_shuffle_ps(right, right, _MM_SHUFFLE(2, 3, 0, 1))),
+		_mm_set_ps(-1.0f, 1.0f, 1.0f, -1.0f)));
+
+	_mm_storeu_ps(result, product);
+#else
+	multiplyScalar(a, b, result);
+#endif
+}
+
+/**
+ * @brief Multiply quaternions, scalar version.
+ *
+ * @param a the quaternion on the left.
+ * @param b the quaternion on the right.
+ * @param result a times b; may be a or b.
+ */
+void Quat::multiplyScalar(const float *a, const float *b, float *result){
+
+	float product[4];
+
+	product[0] = a[3]*b[0] + a[0]*b[3] + a[1]*b[2] - a[2]*b[1];
+	product[1] = a[3]*b[1] - a[0]*b[2] + a[1]*b[3] + a[2]*b[0];
+	product[2] = a[3]*b[2] + a[0]*b[1] - a[1]*b[0] + a[2]*b[3];
+	product[3] = a[3]*b[3] - a[0]*b[0] - a[1]*b[1] - a[2]*b[2];
+
+	memcpy(result, product, sizeof(product));
+}
@@ -0,0 +1,119 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   simdmath.h
+ * @author Rafael Palomar
+ * @date   Fri Jun  4 09:37:52 2010
+ *
+ * @brief  Vec4, Mat4 and Quat classes header.
+ *
+ * This file contains the declaration of the classes Vec4, Mat4 and Quat,
+ * the single precision math used for the scene transforms.
+ *
+ */
+
+#ifndef SIMDMATH_H
+#define SIMDMATH_H
+
+//!Class Vec4.
+/*!
+ * Four component vector. Points have w = 1.
+ */
+class Vec4{
+
+  public:
+	float v[4];
+
+	Vec4();
+	Vec4(float x, float y, float z, float w = 1.0f);
+
+	float x() const;
+	float y() const;
+	float z() const;
+	float w() const;
+
+	Vec4 operator+(const Vec4 &other) const;
+	Vec4 operator-(const Vec4 &other) const;
+	Vec4 operator*(float factor) const;
+
+	float length3() const;
+	static float dot3(const Vec4 &a, const Vec4 &b);
+
+}; //END class Vec4.
+
+//!Class Mat4.
+/*!
+ * 4x4 matrix stored by columns, as the GL takes it. Products are computed
+ * with SSE when the compiler targets it; the scalar versions are kept as
+ * the fallback and as the reference for basicgl_mathbench.
+ */
+class Mat4{
+
+  public:
+	float m[16];
+
+	Mat4();
+
+	static Mat4 translation(float x, float y, float z);
+	static Mat4 scaling(float x, float y, float z);
+	static Mat4 scaling(float factor);
+	static Mat4 rotation(float degrees, float x, float y, float z);
+	static Mat4 perspective(float fovy, float aspect, float nearPlane, float farPlane);
+
+	Mat4 operator*(const Mat4 &other) const;
+	Vec4 operator*(const Vec4 &vector) const;
+
+	Vec4 row(int i) const;
+	Vec4 column(int i) const;
+	const float *data() const;
+
+	static void multiply(const float *a, const float *b, float *result);
+	static void multiplyScalar(const float *a, const float *b, float *result);
+	static void transform(const float *matrix, const float *vector, float *result);
+	static void transformScalar(const float *matrix, const float *vector, float *result);
+
+}; //END class Mat4.
+
+//!Class Quat.
+/*!
+ * Rotation quaternion, stored as x, y, z, w.
+ */
+class Quat{
+
+  public:
+	float q[4];
+
+	Quat();
+	Quat(float x, float y, float z, float w);
+
+	static Quat fromAxisAngle(float degrees, float x, float y, float z);
+
+	Quat operator*(const Quat &other) const;
+	Quat normalized() const;
+	Mat4 toMatrix() const;
+
+	static void multiply(const float *a, const float *b, float *result);
+	static void multiplyScalar(const float *a, const float *b, float *result);
+
+}; //END class Quat.
+
+bool simdEnabled();
+
+#endif
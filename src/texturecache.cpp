@@ -0,0 +1,281 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   texturecache.cpp
+ * @author Rafael Palomar
+ * @date   Fri May 21 16:30:12 2010
+ *
+ * @brief  TextureCache class definition.
+ *
+ * This file contains the definition of the TextureCache class.
+ *
+ */
+
+#include "texturecache.h"
+
+#include <QFileInfo>
+#include <QDateTime>
+#include <QMutexLocker>
+
+/**
+ * @brief Constructor.
+ *
+ * @param budget the number of bytes the cached textures may use.
+ */
+TextureCache::TextureCache(qint64 budget){
+
+	byteBudget = budget;
+	bytesUsed = 0;
+	hitCount = 0;
+	missCount = 0;
+}
+
+/**
+ * @brief Cache key.
+ *
+ * Builds the key of an image file from its absolute path, size and
+ * modification time, so an edited file is loaded again.
+ *
+ * @param fileName the name of the image file.
+ *
+ * @return the key for the file.
+ */
+QString TextureCache::key(const QString &fileName){
+
+	QFileInfo info(fileName);
+
+	return QString("%1|%2|%3").arg(info.absoluteFilePath())
+		.arg(info.size())
+		.arg(info.lastModified().toTime_t());
+}
+
+/**
+ * @brief Contains.
+ *
+ * Looks the key up without pinning its texture, nor counting a hit or a
+ * miss.
+ *
+ * @param key the key of the image file.
+ *
+ * @return true if the image is cached.
+ */
+bool TextureCache::contains(const QString &key) const{
+
+	QMutexLocker locker(&mutex);
+	return entries.contains(key);
+}
+
+/**
+ * @brief Acquire a cached texture.
+ *
+ * Looks the key up and, if found, pins its texture until it is released.
+ *
+ * @param key the key of the image file.
+ *
+ * @return the texture object, or 0 if the image is not cached.
+ */
+GLuint TextureCache::acquire(const QString &key){
+
+	QMutexLocker locker(&mutex);
+	QHash<QString, Entry>::iterator entry = entries.find(key);
+
+	if(entry == entries.end())
+		return 0;
+
+	hitCount++;
+	entry->users++;
+	touch(key);
+	return entry->texture;
+}
+
+/**
+ * @brief Insert a texture.
+ *
+ * Creates a trilinear filtered texture object for the key, pinned as by
+ * acquire(). The caller uploads the image, with its mipmaps, into it.
+ * If the key is already cached its texture is returned instead. A new
+ * texture counts as a miss.
+ *
+ * @param key the key of the image file.
+ * @param bytes the size of the texture in video memory.
+ *
+ * @return the texture object.
+ */
+GLuint TextureCache::insert(const QString &key, qint64 bytes){
+
+	mutex.lock();
+	QHash<QString, Entry>::iterator existing = entries.find(key);
+
+	if(existing != entries.end()){
+		existing->users++;
+		touch(key);
+		GLuint texture = existing->texture;
+		mutex.unlock();
+		return texture;
+	}
+	mutex.unlock();
+
+	Entry entry;
+	entry.bytes = bytes;
+	entry.users = 1;
+
+	glGenTextures(1, &entry.texture);
+	glBindTexture(GL_TEXTURE_2D, entry.texture);
+	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR_MIPMAP_LINEAR); // Trilinear Filtering
+	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);	// Linear Filtering
+
+	mutex.lock();
+	entries.insert(key, entry);
+	recentlyUsed.prepend(key);
+	bytesUsed += bytes;
+	missCount++;
+	mutex.unlock();
+
+	trim();
+
+	return entry.texture;
+}
+
+/**
+ * @brief Release a texture.
+ *
+ * Unpins a texture obtained with acquire() or insert(). It stays cached
+ * until it is evicted.
+ *
+ * @param texture the texture object, 0 is ignored.
+ */
+void TextureCache::release(GLuint texture){
+
+	if(!texture)
+		return;
+
+	QMutexLocker locker(&mutex);
+	QHash<QString, Entry>::iterator entry;
+	for(entry = entries.begin(); entry != entries.end(); ++entry){
+		if(entry->texture == texture){
+			if(entry->users > 0)
+				entry->users--;
+			return;
+		}
+	}
+}
+
+/**
+ * @brief Trim the cache.
+ *
+ * Deletes the least recently used textures that are not pinned until
+ * the cache fits its budget. Deleting a bound texture binds texture 0,
+ * so callers tracking the binding must forget it when this returns true.
+ *
+ * @return true if any texture was deleted.
+ */
+bool TextureCache::trim(){
+
+	QList<GLuint> evicted;
+
+	mutex.lock();
+	for(int i = recentlyUsed.size() - 1; i >= 0 && bytesUsed > byteBudget; i--){
+
+		QHash<QString, Entry>::iterator entry = entries.find(recentlyUsed[i]);
+		if(entry->users > 0)
+			continue;
+
+		evicted.append(entry->texture);
+		bytesUsed -= entry->bytes;
+		entries.erase(entry);
+		recentlyUsed.removeAt(i);
+	}
+	mutex.unlock();
+
+	for(int i = 0; i < evicted.size(); i++)
+		glDeleteTextures(1, &evicted[i]);
+
+	return !evicted.isEmpty();
+}
+
+/**
+ * @brief Set the budget.
+ *
+ * The cache is trimmed to the new budget the next time trim() is called.
+ *
+ * @param bytes the number of bytes the cached textures may use.
+ */
+void TextureCache::setBudget(qint64 bytes){
+
+	QMutexLocker locker(&mutex);
+	byteBudget = bytes;
+}
+
+/**
+ * @brief Budget.
+ *
+ * @return the number of bytes the cached textures may use.
+ */
+qint64 TextureCache::budget() const{
+
+	QMutexLocker locker(&mutex);
+	return byteBudget;
+}
+
+/**
+ * @brief Size.
+ *
+ * @return the number of bytes used by the cached textures.
+ */
+qint64 TextureCache::size() const{
+
+	QMutexLocker locker(&mutex);
+	return bytesUsed;
+}
+
+/**
+ * @brief Hits.
+ *
+ * @return the number of lookups that found the texture cached.
+ */
+quint64 TextureCache::hits() const{
+
+	QMutexLocker locker(&mutex);
+	return hitCount;
+}
+
+/**
+ * @brief Misses.
+ *
+ * @return the number of textures that had to be created.
+ */
+quint64 TextureCache::misses() const{
+
+	QMutexLocker locker(&mutex);
+	return missCount;
+}
+
+/**
+ * @brief Touch an entry.
+ *
+ * Moves the key to the front of the least recently used list.
+ *
+ * @param key the key of a cached texture.
+ */
+void TextureCache::touch(const QString &key){
+
+	recentlyUsed.removeOne(key);
+	recentlyUsed.prepend(key);
+}
@@ -0,0 +1,90 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   texturecache.h
+ * @author Rafael Palomar
+ * @date   Fri May 21 16:08:47 2010
+ *
+ * @brief  TextureCache class header.
+ *
+ * This file contains the declaration of the class TextureCache.
+ *
+ */
+
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QtOpenGL>
+
+//!Class TextureCache.
+/*!
+ * Keeps texture objects resident, keyed by image file path, size and
+ * modification time. Textures in use are pinned; the rest are evicted in
+ * least recently used order when the cache grows over its byte budget.
+ *
+ * Only insert() and trim() make GL calls, so they must be called with
+ * the context current. The entries are guarded by a mutex that is never
+ * held across a GL call, so another thread may look textures up while
+ * the renderer inserts and evicts them.
+ */
+class TextureCache{
+
+  private:
+	//!Cached texture.
+	struct Entry{
+		GLuint texture;
+		qint64 bytes;
+		int users;
+	};
+
+	mutable QMutex mutex;
+	QHash<QString, Entry> entries;
+	QList<QString> recentlyUsed;   //!< Most recently used first.
+	qint64 byteBudget;
+	qint64 bytesUsed;
+	quint64 hitCount;
+	quint64 missCount;
+
+	void touch(const QString &key);
+
+  public:
+	TextureCache(qint64 budget = 64*1024*1024);
+
+	static QString key(const QString &fileName);
+
+	bool contains(const QString &key) const;
+	GLuint acquire(const QString &key);
+	GLuint insert(const QString &key, qint64 bytes);
+	void release(GLuint texture);
+	bool trim();
+
+	void setBudget(qint64 bytes);
+	qint64 budget() const;
+	qint64 size() const;
+	quint64 hits() const;
+	quint64 misses() const;
+
+}; //END class TextureCache.
+
+#endif
@@ -0,0 +1,216 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   textureloader.cpp
+ * @author Rafael Palomar
+ * @date   Wed May 19 17:52:10 2010
+ *
+ * @brief  Texture loader definition.
+ *
+ * This file contains the function that decodes and converts texture
+ * images. It only uses QImage and QFile, so it can run on a worker thread.
+ *
+ */
+
+#include "textureloader.h"
+
+#include <QGLWidget>
+#include <QFileInfo>
+#include <QDateTime>
+
+/**
+ * @brief Nearest power of two.
+ *
+ * @param value a positive size.
+ *
+ * @return the power of two closest to value.
+ */
+static int nearestPowerOfTwo(int value){
+
+	int power = 1;
+	while(power*2 <= value)
+		power *= 2;
+
+	if(value - power > power*2 - value)
+		power *= 2;
+
+	return power;
+}
+
+/**
+ * @brief Power of two.
+ *
+ * @param value a positive size.
+ *
+ * @return true if value is a power of two.
+ */
+static bool isPowerOfTwo(int value){
+
+	return (value & (value - 1)) == 0;
+}
+
+/**
+ * @brief Compiled texture name.
+ *
+ * Finds the KTX file to use instead of decoding an image: the file itself
+ * if it is a KTX file, or a KTX file with the same base name next to the
+ * image that is not older than it (as written by basicgl_ktxconvert).
+ *
+ * @param fileName the name of the image file.
+ *
+ * @return the name of the KTX file, or an empty string if there is none.
+ */
+static QString compiledTextureName(const QString &fileName){
+
+	QFileInfo image(fileName);
+
+	if(image.suffix().toLower() == "ktx")
+		return fileName;
+
+	QFileInfo compiled(image.path() + "/" + image.completeBaseName() + ".ktx");
+
+	if(compiled.exists() && compiled.lastModified() >= image.lastModified())
+		return compiled.filePath();
+
+	return QString();
+}
+
+/**
+ * @brief Usable KTX file.
+ *
+ * @param ktx an opened KTX file.
+ * @param powerOfTwo whether the GL needs power of two sizes.
+ * @param maxSize the largest texture width and height of the GL.
+ * @param compressedTextures whether the GL takes S3TC compressed textures.
+ *
+ * @return true if the levels of the file can be uploaded as they are.
+ */
+static bool isUsable(const KtxFile &ktx, bool powerOfTwo, int maxSize,
+					 bool compressedTextures){
+
+	if(ktx.width() > maxSize || ktx.height() > maxSize)
+		return false;
+
+	if(powerOfTwo && (!isPowerOfTwo(ktx.width()) || !isPowerOfTwo(ktx.height())))
+		return false;
+
+	if(ktx.isCompressed())
+		return compressedTextures
+			&& ktx.glInternalFormat() == GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+
+	return true;
+}
+
+/**
+ * @brief Load texture image.
+ *
+ * This function maps the compiled KTX version of the image when there is
+ * a usable one, so no decoding or conversion is needed. Otherwise it reads
+ * the image file, resamples it if the GL cannot take its size and converts
+ * it to the format expected by glTexImage2D.
+ *
+ * @param fileName the name of the image (or KTX) file.
+ * @param powerOfTwo whether the GL needs power of two sizes.
+ * @param maxSize the largest texture width and height of the GL.
+ * @param compressedTextures whether the GL takes S3TC compressed textures.
+ *
+ * @return the converted image, or the reason why it could not be loaded.
+ */
+TextureImage loadTextureImage(const QString &fileName, bool powerOfTwo, int maxSize,
+							  bool compressedTextures){
+
+	TextureImage texture;
+	texture.fileName = fileName;
+
+	QString ktxFileName = compiledTextureName(fileName);
+
+	if(!ktxFileName.isEmpty()){
+
+		QSharedPointer<KtxFile> ktx(new KtxFile);
+
+		if(ktx->open(ktxFileName)
+		   && isUsable(*ktx, powerOfTwo, maxSize, compressedTextures)){
+			texture.ktx = ktx;
+			texture.status = TextureImage::Loaded;
+			return texture;
+		}
+
+		//There is no image to fall back on.
+		if(ktxFileName == fileName){
+			texture.status = TextureImage::LoadError;
+			return texture;
+		}
+	}
+
+	QImage image;
+
+	if(!image.load(fileName)){
+		texture.status = TextureImage::LoadError;
+		return texture;
+	}
+
+	int width = image.width();
+	int height = image.height();
+
+	if(powerOfTwo){
+		width = nearestPowerOfTwo(width);
+		height = nearestPowerOfTwo(height);
+	}
+
+	//Halving keeps power of two sizes and roughly keeps the aspect ratio.
+	while(width > maxSize || height > maxSize){
+		width = qMax(1, width/2);
+		height = qMax(1, height/2);
+	}
+
+	if(width != image.width() || height != image.height())
+		image = image.scaled(width, height, Qt::IgnoreAspectRatio,
+							 Qt::SmoothTransformation);
+
+	texture.image = QGLWidget::convertToGLFormat(image);
+	texture.status = TextureImage::Loaded;
+	return texture;
+}
+
+/**
+ * @brief Null texture image.
+ *
+ * @return true if there is nothing to upload.
+ */
+bool TextureImage::isNull() const{
+
+	return image.isNull() && ktx.isNull();
+}
+
+/**
+ * @brief Byte count.
+ *
+ * @return the size of the texture in video memory, with its mipmaps.
+ */
+qint64 TextureImage::byteCount() const{
+
+	if(!ktx.isNull()){
+		if(ktx->levels().size() > 1)
+			return ktx->dataSize();
+		return ktx->dataSize()*4/3;
+	}
+
+	return (qint64)image.byteCount()*4/3;
+}
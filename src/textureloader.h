@@ -0,0 +1,66 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   textureloader.h
+ * @author Rafael Palomar
+ * @date   Wed May 19 17:41:22 2010
+ *
+ * @brief  Texture loader header.
+ *
+ * This file contains the declaration of the function that decodes
+ * texture images outside the GUI thread.
+ *
+ */
+
+#ifndef TEXTURELOADER_H
+#define TEXTURELOADER_H
+
+#include <QImage>
+#include <QString>
+#include <QSharedPointer>
+
+#include "ktxfile.h"
+
+//!Texture image decoded and converted to the GL format.
+/*!
+ * Holds either a decoded image or a mapped KTX file with the texture
+ * already in GL format.
+ */
+struct TextureImage{
+
+	//!Result of the decoding.
+	enum Status{
+		Loaded,    //!< The image is ready to be uploaded.
+		LoadError  //!< The file could not be read or decoded.
+	};
+
+	Status status;
+	QString fileName;
+	QImage image;
+	QSharedPointer<KtxFile> ktx;
+
+	bool isNull() const;
+	qint64 byteCount() const;
+};
+
+TextureImage loadTextureImage(const QString &fileName, bool powerOfTwo, int maxSize,
+							  bool compressedTextures);
+
+#endif
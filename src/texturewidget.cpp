@@ -105,7 +105,7 @@ void TextureWidget::browseCubeTexture(){
 	QString imageFileName =  QFileDialog::getOpenFileName(this,
 														  "Open Image", 
 														  "./", 
-														  "Image Files (*.png *.jpg *.bmp)");
+														  "Image Files (*.png *.jpg *.bmp *.ktx)");
 	cubeTexFileLineEdit->setText(imageFileName);
 }
 
@@ -121,7 +121,7 @@ void TextureWidget::browseFloorTexture(){
 	QString imageFileName =  QFileDialog::getOpenFileName(this,
 														  "Open Image", 
 														  "./", 
-														  "Image Files (*.png *.jpg *.bmp)");
+														  "Image Files (*.png *.jpg *.bmp *.ktx)");
 	
 	floorTexFileLineEdit->setText(imageFileName);
 }
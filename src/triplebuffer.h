@@ -0,0 +1,134 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   triplebuffer.h
+ * @author Rafael Palomar
+ * @date   Wed Jun  9 10:12:08 2010
+ *
+ * @brief  TripleBuffer class template header.
+ *
+ * This file contains the declaration and definition of the class
+ * template TripleBuffer.
+ *
+ */
+
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <QAtomicInt>
+
+//!Class template TripleBuffer.
+/*!
+ * Lock-free mailbox between one producer thread and one consumer thread.
+ * The producer fills its own buffer and publishes it; the consumer takes
+ * the latest published buffer whenever it likes. Neither ever waits for
+ * the other, versions published in between are skipped, and a buffer is
+ * never read while it is being written.
+ *
+ * The three buffers are owned by the producer, the consumer and the
+ * mailbox itself. Publishing and taking swap the owned buffer with the
+ * one in the mailbox, whose index is kept in an atomic integer along
+ * with a flag telling whether it holds a version not taken yet.
+ */
+template<class T>
+class TripleBuffer{
+
+  private:
+	enum{
+		IndexMask = 3, //!< Bits of the index of the buffer in the mailbox.
+		Fresh = 4      //!< Set when the mailbox holds a version not taken yet.
+	};
+
+	T buffers[3];
+	QAtomicInt mailbox;
+	int back;  //!< Buffer of the producer.
+	int front; //!< Buffer of the consumer.
+
+	TripleBuffer(const TripleBuffer &);
+	TripleBuffer &operator=(const TripleBuffer &);
+
+  public:
+	/**
+	 * @brief Constructor.
+	 *
+	 * The buffers are default constructed, so the consumer reads a
+	 * default value until the first version is published.
+	 */
+	TripleBuffer(): mailbox(1), back(0), front(2){}
+
+	/**
+	 * @brief Write buffer.
+	 *
+	 * Only to be used by the producer. It holds an older version, so it
+	 * has to be written whole before it is published.
+	 *
+	 * @return the buffer of the producer.
+	 */
+	T &writeBuffer(){
+
+		return buffers[back];
+	}
+
+	/**
+	 * @brief Publish.
+	 *
+	 * Only to be used by the producer. Makes the write buffer the latest
+	 * version and hands the producer the buffer left in the mailbox.
+	 */
+	void publish(){
+
+		//Ordered: the writes to the buffer are released with it, and the
+		//reads of the consumer from the buffer taken back are done.
+		back = mailbox.fetchAndStoreOrdered(back | Fresh) & IndexMask;
+	}
+
+	/**
+	 * @brief Take.
+	 *
+	 * Only to be used by the consumer. Makes the latest version the read
+	 * buffer, if one was published since the last call.
+	 *
+	 * @return true if the read buffer changed.
+	 */
+	bool take(){
+
+		//Only the producer sets the flag, so it stays set until the swap.
+		if(!((int)mailbox & Fresh))
+			return false;
+
+		front = mailbox.fetchAndStoreOrdered(front) & IndexMask;
+		return true;
+	}
+
+	/**
+	 * @brief Read buffer.
+	 *
+	 * Only to be used by the consumer.
+	 *
+	 * @return the latest version taken.
+	 */
+	const T &readBuffer() const{
+
+		return buffers[front];
+	}
+
+}; //END class template TripleBuffer.
+
+#endif
@@ -0,0 +1,672 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   videorecorder.cpp
+ * @author Rafael Palomar
+ * @date   Thu Jun 24 17:36:10 2010
+ *
+ * @brief  VideoRecorder class definition.
+ *
+ * This file contains the definition of the VideoRecorder class.
+ *
+ */
+
+#include "videorecorder.h"
+
+#include <QTextStream>
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VIDEORECORDER_SSE2
+#include <emmintrin.h>
+#endif
+
+//!Size of the writes to the file.
+static const int writeChunk = 8*1024*1024;
+
+/**
+ * @brief Luma.
+ *
+ * Full range BT.601, in 8 bit fixed point.
+ *
+ * @param pixel a BGRA pixel.
+ *
+ * @return the Y component.
+ */
+static inline uchar luma(const uchar *pixel){
+
+	return (uchar)((29*pixel[0] + 150*pixel[1] + 77*pixel[2] + 128) >> 8);
+}
+
+/**
+ * @brief Chroma.
+ *
+ * Full range BT.601, in 8 bit fixed point, of the average of four pixels.
+ *
+ * @param a first pixel.
+ * @param b second pixel.
+ * @param c third pixel.
+ * @param d fourth pixel.
+ * @param u the U component.
+ * @param v the V component.
+ */
+static inline void chroma(const uchar *a, const uchar *b, const uchar *c, const uchar *d,
+						  uchar &u, uchar &v){
+
+	int blue = (a[0] + b[0] + c[0] + d[0] + 2) >> 2;
+	int green = (a[1] + b[1] + c[1] + d[1] + 2) >> 2;
+	int red = (a[2] + b[2] + c[2] + d[2] + 2) >> 2;
+
+	u = (uchar)qBound(0, ((128*blue - 85*green - 43*red + 128) >> 8) + 128, 255);
+	v = (uchar)qBound(0, ((-21*blue - 107*green + 128*red + 128) >> 8) + 128, 255);
+}
+
+/**
+ * @brief Convert a row pair.
+ *
+ * Converts two rows of pixels to I420, from a given column on.
+ *
+ * @param row0 the upper row.
+ * @param row1 the lower row, row0 for the last row of an odd height.
+ * @param width pixels per row.
+ * @param from first column to convert, even.
+ * @param y0 luma of the upper row.
+ * @param y1 luma of the lower row.
+ * @param u chroma U of the row pair.
+ * @param v chroma V of the row pair.
+ */
+static void convertRowPair(const uchar *row0, const uchar *row1, int width, int from,
+						   uchar *y0, uchar *y1, uchar *u, uchar *v){
+
+	for(int x = from; x < width; x++){
+		y0[x] = luma(row0 + 4*x);
+		y1[x] = luma(row1 + 4*x);
+	}
+
+	for(int x = from; x < width; x += 2){
+		int next = qMin(x + 1, width - 1);
+		chroma(row0 + 4*x, row0 + 4*next, row1 + 4*x, row1 + 4*next, u[x/2], v[x/2]);
+	}
+}
+
+#ifdef VIDEORECORDER_SSE2
+
+/**
+ * @brief Deinterleave.
+ *
+ * Splits eight BGRA pixels into 16 bit channels.
+ *
+ * @param pixels the pixels.
+ * @param blue the blue channel.
+ * @param green the green channel.
+ * @param red the red channel.
+ */
+static inline void deinterleave(const uchar *pixels, __m128i &blue, __m128i &green, __m128i &red){
+
+	__m128i mask = _mm_set1_epi32(0xFF);
+	__m128i p0 = _mm_loadu_si128((const __m128i *)pixels);
+	__m128i p1 = _mm_loadu_si128((const __m128i *)(pixels + 16));
+
+	blue = _mm_packs_epi32(_mm_and_si128(p0, mask), _mm_and_si128(p1, mask));
+	green = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), mask),
+							_mm_and_si128(_mm_srli_epi32(p1, 8), mask));
+	red = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), mask),
+						  _mm_and_si128(_mm_srli_epi32(p1, 16), mask));
+}
+
+/**
+ * @brief Luma of eight pixels.
+ *
+ * The sum reaches 65408, so it wraps as a signed 16 bit value but is
+ * right once shifted as an unsigned one.
+ *
+ * @return the eight Y components, in 16 bit lanes.
+ */
+static inline __m128i luma8(__m128i blue, __m128i green, __m128i red){
+
+	__m128i sum = _mm_add_epi16(_mm_mullo_epi16(blue, _mm_set1_epi16(29)),
+								_mm_mullo_epi16(green, _mm_set1_epi16(150)));
+	sum = _mm_add_epi16(sum, _mm_mullo_epi16(red, _mm_set1_epi16(77)));
+	return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(128)), 8);
+}
+
+/**
+ * @brief Average of 2x2 blocks.
+ *
+ * @param row0 a channel of eight pixels of the upper row.
+ * @param row1 the same channel of the lower row.
+ *
+ * @return the four averages, in the low 16 bit lanes.
+ */
+static inline __m128i average4(__m128i row0, __m128i row1){
+
+	__m128i sum = _mm_madd_epi16(_mm_add_epi16(row0, row1), _mm_set1_epi16(1));
+	sum = _mm_srli_epi32(_mm_add_epi32(sum, _mm_set1_epi32(2)), 2);
+	return _mm_packs_epi32(sum, sum);
+}
+
+/**
+ * @brief Chroma component of four blocks.
+ *
+ * @param blue averaged blue.
+ * @param green averaged green.
+ * @param red averaged red.
+ * @param coefficients BGR coefficients, in 8 bit fixed point.
+ *
+ * @return the four components, in the low bytes.
+ */
+static inline int chroma4(__m128i blue, __m128i green, __m128i red, const short *coefficients){
+
+	__m128i redGreen = _mm_madd_epi16(_mm_unpacklo_epi16(red, green),
+									  _mm_setr_epi16(coefficients[2], coefficients[1],
+													 coefficients[2], coefficients[1],
+													 coefficients[2], coefficients[1],
+													 coefficients[2], coefficients[1]));
+	__m128i blueBias = _mm_madd_epi16(_mm_unpacklo_epi16(blue, _mm_set1_epi16(1)),
+									  _mm_setr_epi16(coefficients[0], 128, coefficients[0], 128,
+													 coefficients[0], 128, coefficients[0], 128));
+	__m128i sum = _mm_srai_epi32(_mm_add_epi32(redGreen, blueBias), 8);
+	sum = _mm_add_epi32(sum, _mm_set1_epi32(128));
+	sum = _mm_packs_epi32(sum, sum);
+	return _mm_cvtsi128_si32(_mm_packus_epi16(sum, sum));
+}
+
+static const short uCoefficients[3] = {128, -85, -43};  //!< B, G, R.
+static const short vCoefficients[3] = {-21, -107, 128}; //!< B, G, R.
+
+#endif
+
+/**
+ * @brief Constructor.
+ *
+ * The recorder is idle until startRecording().
+ */
+VideoRecorder::VideoRecorder(){
+
+	format = Y4M;
+	frameRate = 60;
+	stopping = false;
+	started = false;
+	lastNumber = 0;
+	width = 0;
+	height = 0;
+	firstTime = 0;
+	lastSlot = -1;
+	writeFill = 0;
+	writeFailed = false;
+	written = 0;
+	duplicated = 0;
+	coalesced = 0;
+	dropped = 0;
+}
+
+/**
+ * @brief Destructor.
+ *
+ * Stops the recording. The recorder must no longer be a frame consumer.
+ */
+VideoRecorder::~VideoRecorder(){
+
+	stopRecording();
+}
+
+/**
+ * @brief Start recording.
+ *
+ * Creates the file and starts the recorder thread. Files named *.y4m are
+ * written as Y4M, others as raw RGBA.
+ *
+ * @param fileName the file to record to.
+ * @param framesPerSecond frame rate of the recording.
+ *
+ * @return false if the file cannot be created.
+ */
+bool VideoRecorder::startRecording(const QString &fileName, int framesPerSecond){
+
+	stopRecording();
+
+	file.setFileName(fileName);
+	if(framesPerSecond <= 0
+	   || !file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered))
+		return false;
+
+	format = fileName.endsWith(".y4m", Qt::CaseInsensitive) ? Y4M : RawRGBA;
+	frameRate = framesPerSecond;
+	width = 0;
+	height = 0;
+	lastSlot = -1;
+	writeFill = 0;
+	writeFailed = false;
+	writeBuffer.resize(writeChunk);
+
+	//The rendering thread may already be delivering frames.
+	QMutexLocker locker(&mutex);
+	stopping = false;
+	started = false;
+	written = 0;
+	duplicated = 0;
+	coalesced = 0;
+	dropped = 0;
+	queue.clear();
+	freeBuffers.clear();
+	for(int i = 0; i < queuedFrames; i++)
+		freeBuffers.append(QByteArray());
+	locker.unlock();
+
+	start();
+	return true;
+}
+
+/**
+ * @brief Stop recording.
+ *
+ * Writes the frames still queued, closes the file and reports the
+ * frames written, duplicated and dropped on stderr.
+ */
+void VideoRecorder::stopRecording(){
+
+	if(!file.isOpen())
+		return;
+
+	mutex.lock();
+	stopping = true;
+	wakeUp.wakeOne();
+	mutex.unlock();
+
+	wait();
+	file.close();
+
+	QTextStream err(stderr);
+	err << "basicGL: recorded " << framesWritten() << " frames to " << file.fileName()
+		<< " (" << framesDuplicated() << " duplicated, " << framesCoalesced()
+		<< " coalesced, " << framesDropped() << " dropped)\n";
+	if(writeFailed)
+		err << "basicGL: " << file.fileName() << " could not be fully written\n";
+}
+
+/**
+ * @brief Frame captured.
+ *
+ * Copies the frame into a free buffer and queues it for the recorder
+ * thread, or drops it if every buffer is queued.
+ *
+ * @param frame the frame read back.
+ */
+void VideoRecorder::frameCaptured(const CapturedFrame &frame){
+
+	QMutexLocker locker(&mutex);
+
+	if(stopping)
+		return;
+
+	//Frames the capture itself dropped.
+	if(started && frame.number > lastNumber + 1)
+		dropped += frame.number - lastNumber - 1;
+	started = true;
+	lastNumber = frame.number;
+
+	if(freeBuffers.isEmpty()){
+		dropped++;
+		return;
+	}
+
+	Frame copy;
+	copy.pixels = freeBuffers.takeLast();
+	copy.width = frame.width;
+	copy.height = frame.height;
+	copy.time = frame.time;
+
+	//The copy is the only work done on the rendering thread.
+	locker.unlock();
+
+	int rowBytes = frame.width*4;
+	copy.pixels.resize(rowBytes*frame.height);
+	uchar *pixels = (uchar *)copy.pixels.data();
+	if(frame.bytesPerLine == rowBytes)
+		memcpy(pixels, frame.pixels, rowBytes*frame.height);
+	else
+		for(int row = 0; row < frame.height; row++)
+			memcpy(pixels + row*rowBytes, frame.pixels + row*frame.bytesPerLine, rowBytes);
+
+	locker.relock();
+
+	//stopRecording() came in during the copy; the recorder thread may
+	//already have drained the queue.
+	if(stopping){
+		dropped++;
+		freeBuffers.append(copy.pixels);
+		return;
+	}
+
+	queue.enqueue(copy);
+	wakeUp.wakeOne();
+}
+
+/**
+ * @brief Run.
+ *
+ * Writes the queued frames until the recording stops.
+ */
+void VideoRecorder::run(){
+
+	forever{
+
+		mutex.lock();
+		while(queue.isEmpty() && !stopping)
+			wakeUp.wait(&mutex);
+
+		if(queue.isEmpty()){
+			mutex.unlock();
+			break;
+		}
+
+		Frame frame = queue.dequeue();
+		mutex.unlock();
+
+		writeFrame(frame);
+
+		mutex.lock();
+		freeBuffers.append(frame.pixels);
+		//Unshared, so the next copy into it does not reallocate.
+		frame.pixels = QByteArray();
+		mutex.unlock();
+	}
+
+	flushWrites();
+}
+
+/**
+ * @brief Write frame.
+ *
+ * Places a frame on the timeline of the recording and writes it, after
+ * repeating the previous frame over the slots left without one.
+ *
+ * @param frame the frame.
+ */
+void VideoRecorder::writeFrame(const Frame &frame){
+
+	if(lastSlot < 0){
+		width = frame.width;
+		height = frame.height;
+		firstTime = frame.time;
+
+		if(format == Y4M){
+			QByteArray header = QString("YUV4MPEG2 W%1 H%2 F%3:1 Ip A1:1 C420jpeg\n")
+				.arg(width).arg(height).arg(frameRate).toAscii();
+			append(header.constData(), header.size());
+		}
+	}
+
+	qint64 period = 1000000000LL/frameRate;
+	qint64 slot = (frame.time - firstTime + period/2)/period;
+
+	//The file has a single size.
+	if(frame.width != width || frame.height != height){
+		QMutexLocker locker(&mutex);
+		dropped++;
+		return;
+	}
+
+	//Rendered in the same slot as the frame before, which is kept.
+	if(slot <= lastSlot){
+		QMutexLocker locker(&mutex);
+		coalesced++;
+		return;
+	}
+
+	for(qint64 repeat = lastSlot + 1; lastSlot >= 0 && repeat < slot; repeat++){
+		if(format == Y4M)
+			append("FRAME\n", 6);
+		append(converted.constData(), converted.size());
+
+		QMutexLocker locker(&mutex);
+		written++;
+		duplicated++;
+	}
+
+	const uchar *pixels = (const uchar *)frame.pixels.constData();
+
+	if(format == Y4M){
+		converted.resize(width*height + 2*((width + 1)/2)*((height + 1)/2));
+		convertToI420(pixels, width, height, width*4, (uchar *)converted.data());
+		append("FRAME\n", 6);
+	}
+	else{
+		converted.resize(width*height*4);
+		convertToRGBA(pixels, width, height, width*4, (uchar *)converted.data());
+	}
+
+	append(converted.constData(), converted.size());
+	lastSlot = slot;
+
+	QMutexLocker locker(&mutex);
+	written++;
+}
+
+/**
+ * @brief Append.
+ *
+ * Adds data to the write buffer, writing it to the file in chunks.
+ *
+ * @param data the data.
+ * @param size its size in bytes.
+ */
+void VideoRecorder::append(const char *data, int size){
+
+	if(writeFill + size > writeBuffer.size())
+		flushWrites();
+
+	if(size >= writeBuffer.size()){
+		if(file.write(data, size) != size)
+			writeFailed = true;
+		return;
+	}
+
+	memcpy(writeBuffer.data() + writeFill, data, size);
+	writeFill += size;
+}
+
+/**
+ * @brief Flush writes.
+ *
+ * Writes the write buffer to the file.
+ */
+void VideoRecorder::flushWrites(){
+
+	if(writeFill > 0 && file.write(writeBuffer.constData(), writeFill) != writeFill)
+		writeFailed = true;
+	writeFill = 0;
+}
+
+/**
+ * @brief Frames written.
+ *
+ * @return the number of frames in the file, duplicates included.
+ */
+quint64 VideoRecorder::framesWritten() const{
+
+	QMutexLocker locker(&mutex);
+	return written;
+}
+
+/**
+ * @brief Frames duplicated.
+ *
+ * @return the number of frames repeated to fill slots without a frame.
+ */
+quint64 VideoRecorder::framesDuplicated() const{
+
+	QMutexLocker locker(&mutex);
+	return duplicated;
+}
+
+/**
+ * @brief Frames coalesced.
+ *
+ * @return the number of frames rendered within the slot of the frame
+ * before them, and so left out of the recording.
+ */
+quint64 VideoRecorder::framesCoalesced() const{
+
+	QMutexLocker locker(&mutex);
+	return coalesced;
+}
+
+/**
+ * @brief Frames dropped.
+ *
+ * @return the number of frames rendered but lost before being recorded.
+ */
+quint64 VideoRecorder::framesDropped() const{
+
+	QMutexLocker locker(&mutex);
+	return dropped;
+}
+
+/**
+ * @brief Convert to I420.
+ *
+ * Converts captured pixels to planar 4:2:0, full range BT.601, with the
+ * top row first. Eight pixels of two rows are converted at a time with
+ * SSE2 when the compiler targets it.
+ *
+ * @param pixels BGRA pixels, bottom row first.
+ * @param width width of the frame.
+ * @param height height of the frame.
+ * @param bytesPerLine bytes from a row of pixels to the next.
+ * @param planes the Y, U and V planes, one after the other.
+ */
+void VideoRecorder::convertToI420(const uchar *pixels, int width, int height,
+								  int bytesPerLine, uchar *planes){
+
+#ifdef VIDEORECORDER_SSE2
+	int chromaWidth = (width + 1)/2;
+	uchar *lumaPlane = planes;
+	uchar *uPlane = planes + width*height;
+	uchar *vPlane = uPlane + chromaWidth*((height + 1)/2);
+
+	for(int row = 0; row < height; row += 2){
+
+		int next = qMin(row + 1, height - 1);
+		const uchar *row0 = pixels + (height - 1 - row)*bytesPerLine;
+		const uchar *row1 = pixels + (height - 1 - next)*bytesPerLine;
+		uchar *y0 = lumaPlane + row*width;
+		uchar *y1 = lumaPlane + next*width;
+		uchar *u = uPlane + (row/2)*chromaWidth;
+		uchar *v = vPlane + (row/2)*chromaWidth;
+
+		int x = 0;
+		for(; x + 8 <= width; x += 8){
+
+			__m128i blue0, green0, red0, blue1, green1, red1;
+			deinterleave(row0 + 4*x, blue0, green0, red0);
+			deinterleave(row1 + 4*x, blue1, green1, red1);
+
+			__m128i luma0 = luma8(blue0, green0, red0);
+			__m128i luma1 = luma8(blue1, green1, red1);
+			_mm_storel_epi64((__m128i *)(y0 + x), _mm_packus_epi16(luma0, luma0));
+			_mm_storel_epi64((__m128i *)(y1 + x), _mm_packus_epi16(luma1, luma1));
+
+			__m128i blue = average4(blue0, blue1);
+			__m128i green = average4(green0, green1);
+			__m128i red = average4(red0, red1);
+			int chromaU = chroma4(blue, green, red, uCoefficients);
+			int chromaV = chroma4(blue, green, red, vCoefficients);
+			memcpy(u + x/2, &chromaU, 4);
+			memcpy(v + x/2, &chromaV, 4);
+		}
+
+		convertRowPair(row0, row1, width, x, y0, y1, u, v);
+	}
+#else
+	convertToI420Scalar(pixels, width, height, bytesPerLine, planes);
+#endif
+}
+
+/**
+ * @brief Convert to I420, scalar version.
+ *
+ * Same as convertToI420(), one pixel at a time. Kept as the fallback and
+ * as its reference.
+ *
+ * @param pixels BGRA pixels, bottom row first.
+ * @param width width of the frame.
+ * @param height height of the frame.
+ * @param bytesPerLine bytes from a row of pixels to the next.
+ * @param planes the Y, U and V planes, one after the other.
+ */
+void VideoRecorder::convertToI420Scalar(const uchar *pixels, int width, int height,
+										int bytesPerLine, uchar *planes){
+
+	int chromaWidth = (width + 1)/2;
+	uchar *uPlane = planes + width*height;
+	uchar *vPlane = uPlane + chromaWidth*((height + 1)/2);
+
+	for(int row = 0; row < height; row += 2){
+
+		int next = qMin(row + 1, height - 1);
+		convertRowPair(pixels + (height - 1 - row)*bytesPerLine,
+					   pixels + (height - 1 - next)*bytesPerLine, width, 0,
+					   planes + row*width, planes + next*width,
+					   uPlane + (row/2)*chromaWidth, vPlane + (row/2)*chromaWidth);
+	}
+}
+
+/**
+ * @brief Convert to RGBA.
+ *
+ * Swaps the red and blue bytes of captured pixels and puts the top row
+ * first, four pixels at a time with SSE2 when the compiler targets it.
+ *
+ * @param pixels BGRA pixels, bottom row first.
+ * @param width width of the frame.
+ * @param height height of the frame.
+ * @param bytesPerLine bytes from a row of pixels to the next.
+ * @param rgba the RGBA pixels, top row first.
+ */
+void VideoRecorder::convertToRGBA(const uchar *pixels, int width, int height,
+								  int bytesPerLine, uchar *rgba){
+
+	for(int row = 0; row < height; row++){
+
+		const uchar *source = pixels + (height - 1 - row)*bytesPerLine;
+		uchar *target = rgba + row*width*4;
+		int x = 0;
+
+#ifdef VIDEORECORDER_SSE2
+		__m128i redBlue = _mm_set1_epi32(0x00FF00FF);
+		for(; x + 4 <= width; x += 4){
+			__m128i bgra = _mm_loadu_si128((const __m128i *)(source + 4*x));
+			__m128i swapped = _mm_and_si128(bgra, redBlue);
+			swapped = _mm_or_si128(_mm_slli_epi32(swapped, 16), _mm_srli_epi32(swapped, 16));
+			swapped = _mm_or_si128(swapped, _mm_andnot_si128(redBlue, bgra));
+			_mm_storeu_si128((__m128i *)(target + 4*x), swapped);
+		}
+#endif
+
+		for(; x < width; x++){
+			target[4*x] = source[4*x + 2];
+			target[4*x + 1] = source[4*x + 1];
+			target[4*x + 2] = source[4*x];
+			target[4*x + 3] = source[4*x + 3];
+		}
+	}
+}
@@ -0,0 +1,135 @@
+/*************************************************************************
+  Copyright (c) 2010 Rafael Palomar
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY;
+  without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+
+/**
+ * @file   videorecorder.h
+ * @author Rafael Palomar
+ * @date   Thu Jun 24 17:36:10 2010
+ *
+ * @brief  VideoRecorder class header.
+ *
+ * This file contains the declaration of the class VideoRecorder.
+ *
+ */
+
+#ifndef VIDEORECORDER_H
+#define VIDEORECORDER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QMutex>
+#include <QQueue>
+#include <QThread>
+#include <QWaitCondition>
+
+#include "framecapture.h"
+
+//!Class VideoRecorder.
+/*!
+ * Records the frames captured from a GLWidget into a Y4M file (4:2:0,
+ * full range) or, for other file names, a raw RGBA file of top down rows.
+ *
+ * The rendering thread only copies each frame into a free buffer; the
+ * conversion and the writes happen on the recorder thread, and the file
+ * is written in large chunks. If no buffer is free the frame is dropped,
+ * so recording never holds back rendering.
+ *
+ * Frames are placed on a fixed rate timeline by the time they were
+ * rendered. Frames falling on a slot already written are coalesced into
+ * it, as the widget paces its frames slightly faster than the timeline,
+ * and slots with no frame repeat the previous one, as the widget only
+ * renders when something changes. Only frames that were lost are counted
+ * as dropped: those the capture could not read back, those with no free
+ * buffer and those of another size.
+ */
+class VideoRecorder: public QThread, public FrameConsumer{
+
+  public:
+	//!Output file formats.
+	enum Format{
+		Y4M,   //!< YUV4MPEG2, 4:2:0.
+		RawRGBA
+	};
+
+  private:
+	//!Frame copied from the capture, waiting to be written.
+	struct Frame{
+		QByteArray pixels;
+		int width;
+		int height;
+		qint64 time;
+	};
+
+	//!Frames that may wait for the recorder thread.
+	static const int queuedFrames = 4;
+
+	QFile file;
+	Format format;
+	int frameRate;
+	mutable QMutex mutex;
+	QWaitCondition wakeUp;
+	QQueue<Frame> queue;
+	QList<QByteArray> freeBuffers;
+	bool stopping;
+	bool started;
+	quint64 lastNumber;
+	int width;
+	int height;
+	qint64 firstTime;
+	qint64 lastSlot;
+	QByteArray converted;
+	QByteArray writeBuffer;
+	int writeFill;
+	bool writeFailed;
+	quint64 written;
+	quint64 duplicated;
+	quint64 coalesced;
+	quint64 dropped;
+
+	void writeFrame(const Frame &frame);
+	void append(const char *data, int size);
+	void flushWrites();
+
+  protected:
+	void run();
+
+  public:
+	VideoRecorder();
+	~VideoRecorder();
+
+	bool startRecording(const QString &fileName, int framesPerSecond = 60);
+	void stopRecording();
+	void frameCaptured(const CapturedFrame &frame);
+
+	quint64 framesWritten() const;
+	quint64 framesDuplicated() const;
+	quint64 framesCoalesced() const;
+	quint64 framesDropped() const;
+
+	static void convertToI420(const uchar *pixels, int width, int height,
+							  int bytesPerLine, uchar *planes);
+	static void convertToI420Scalar(const uchar *pixels, int width, int height,
+									int bytesPerLine, uchar *planes);
+	static void convertToRGBA(const uchar *pixels, int width, int height,
+							  int bytesPerLine, uchar *rgba);
+
+}; //END class VideoRecorder.
+
+#endif